@@ -3,7 +3,86 @@
  */
 
 #include <stdlib.h>
+#include <limits.h>
 #include "app_controller.h"
+#include "config.h"
+
+/**
+ * Make sure a track's gain is known, or at least on its way, before it loads.
+ * Renders measure it right here so every render of a queue is identical.
+ */
+static void app_controller_prepare_gain(AppController *controller, const char *path)
+{
+    if (controller->measure_first)
+        loudness_measure(controller->loudness, path);
+    else
+        loudness_scan(controller->loudness, path, 1);
+}
+
+/**
+ * Preload the track that follows the current one on track end, so the
+ * player can start it without a gap.
+ */
+static void app_controller_preload_next(AppController *controller)
+{
+    if (!controller || !controller->player->is_playing || player_is_loading(controller->player))
+        return;
+
+    int next_index = -1;
+    if (queue_peek_next_on_end(controller->queue, &next_index) != QUEUE_NEXT_PLAY)
+    {
+        player_cancel_preload(controller->player);
+        return;
+    }
+
+    const char *path = queue_get_item(controller->queue, (size_t)next_index);
+
+    // Measured ahead of the rest so the gain is known before it starts
+    if (path)
+        app_controller_prepare_gain(controller, path);
+
+    if (!path || player_preload_next(controller->player, path) != 0)
+        player_cancel_preload(controller->player);
+}
+
+/**
+ * Remember the length of the track that just started in the library index
+ */
+static void app_controller_note_duration(AppController *controller)
+{
+    const char *path = player_get_current_file(controller->player);
+    if (path)
+        library_set_duration(controller->library, path, player_get_duration(controller->player));
+}
+
+/**
+ * Gain lookup handed to the player (loader or main thread)
+ */
+static int app_controller_track_gain(void *user_data, const char *filepath, float *gain)
+{
+    return loudness_get_gain((Loudness *)user_data, filepath, gain);
+}
+
+/**
+ * Scanner result callback (worker thread): let the main loop refresh gains
+ */
+static void app_controller_on_loudness(void *user_data)
+{
+    player_wake((Player *)user_data);
+}
+
+/**
+ * Queue every track of the queue for loudness scanning, in queue order
+ */
+static void app_controller_scan_queue(AppController *controller)
+{
+    loudness_cancel(controller->loudness);
+    if (controller->measure_first)
+        return;
+
+    for (size_t i = 0; i < queue_count(controller->queue); i++)
+        loudness_scan(controller->loudness, queue_get_item(controller->queue, i), 0);
+}
 
 static int app_controller_play_current(AppController *controller)
 {
@@ -15,7 +94,16 @@ static int app_controller_play_current(AppController *controller)
         return -1;
 
     player_set_loop(controller->player, 0);
-    return player_play(controller->player, path);
+    app_controller_prepare_gain(controller, path);
+    if (player_play_async(controller->player, path) != 0)
+        return -1;
+
+    if (!player_is_loading(controller->player))
+        app_controller_note_duration(controller);
+
+    // A track that still loads gets its successor once it has started
+    app_controller_preload_next(controller);
+    return 0;
 }
 
 AppController *app_controller_create(Player *player)
@@ -28,6 +116,7 @@ AppController *app_controller_create(Player *player)
         return NULL;
 
     controller->player = player;
+    controller->measure_first = 0;
     controller->queue = queue_create();
     if (!controller->queue)
     {
@@ -35,6 +124,34 @@ AppController *app_controller_create(Player *player)
         return NULL;
     }
 
+    // shuffle_seed makes the shuffle order repeatable for a given queue
+    queue_set_shuffle_seed(controller->queue, (unsigned long)config_get_long("shuffle_seed", 0));
+
+    long history_depth = config_get_long("history_depth", 1000);
+    queue_set_history_depth(controller->queue, history_depth > 0 ? (size_t)history_depth : 0);
+
+    // Without an index, folders are simply listed from disk every time
+    controller->library = library_open();
+    queue_set_scan_cache(controller->queue, library_scan_cache(controller->library));
+
+    // loudness=0 plays every track at its mastered level
+    controller->loudness = NULL;
+    if (config_get_long("loudness", 1))
+    {
+        long threads = config_get_long("loudness_threads", 1);
+        if (threads < 1)
+            threads = 1;
+        if (threads > LOUDNESS_MAX_THREADS)
+            threads = LOUDNESS_MAX_THREADS;
+
+        controller->loudness = loudness_create((int)threads,
+                                               config_get_double("loudness_target", LOUDNESS_TARGET_LUFS),
+                                               config_get_long("loudness_limit", 1) != 0,
+                                               app_controller_on_loudness, player);
+        if (controller->loudness)
+            player_set_gain_lookup(player, app_controller_track_gain, controller->loudness);
+    }
+
     return controller;
 }
 
@@ -43,15 +160,31 @@ void app_controller_destroy(AppController *controller)
     if (!controller)
         return;
 
+    // Waits out any lookup still running on the loader thread, then the
+    // workers stop before the player can go away under their callback
+    player_set_gain_lookup(controller->player, NULL, NULL);
+    loudness_destroy(controller->loudness);
     queue_destroy(controller->queue);
+    library_close(controller->library);
     free(controller);
 }
 
+void app_controller_set_measure_first(AppController *controller, int enabled)
+{
+    if (controller)
+        controller->measure_first = enabled != 0;
+}
+
 const Queue *app_controller_get_queue(const AppController *controller)
 {
     return controller ? controller->queue : NULL;
 }
 
+Library *app_controller_get_library(const AppController *controller)
+{
+    return controller ? controller->library : NULL;
+}
+
 int app_controller_play_file_now(AppController *controller, const char *filepath)
 {
     if (!controller || !filepath)
@@ -67,21 +200,20 @@ int app_controller_play_file_now(AppController *controller, const char *filepath
     return app_controller_play_current(controller);
 }
 
-int app_controller_load_playlist_folder(AppController *controller, const char *folderpath)
+/**
+ * Start a freshly loaded queue where the queue picks (the first track of
+ * the shuffle order when shuffling)
+ * loaded: Result of the load
+ * Returns loaded on success, -1 on failure
+ */
+static int app_controller_start_loaded(AppController *controller, int loaded)
 {
-    if (!controller || !folderpath)
-        return -1;
-
-    int loaded = queue_load_folder(controller->queue, folderpath);
     if (loaded <= 0)
         return loaded;
 
-    int start_index = 0;
-    if (queue_get_shuffle(controller->queue) && loaded > 1)
-    {
-        start_index = rand() % loaded;
-    }
+    app_controller_scan_queue(controller);
 
+    int start_index = queue_pick_start_index(controller->queue);
     if (queue_set_current_index(controller->queue, start_index) != 0)
         return -1;
 
@@ -91,6 +223,32 @@ int app_controller_load_playlist_folder(AppController *controller, const char *f
     return loaded;
 }
 
+int app_controller_load_playlist_folder(AppController *controller, const char *folderpath)
+{
+    if (!controller || !folderpath)
+        return -1;
+
+    // The library index is keyed by absolute paths
+    char resolved[PATH_MAX];
+    const char *scan_path = realpath(folderpath, resolved) ? resolved : folderpath;
+
+    // scan_recursive=1 loads Artist/Album/track trees in one go
+    int loaded = config_get_long("scan_recursive", 0)
+                     ? queue_load_folder_recursive(controller->queue, scan_path)
+                     : queue_load_folder(controller->queue, scan_path);
+
+    library_commit(controller->library);
+    return app_controller_start_loaded(controller, loaded);
+}
+
+int app_controller_load_playlist(AppController *controller, const char *const *paths, size_t count)
+{
+    if (!controller || !paths)
+        return -1;
+
+    return app_controller_start_loaded(controller, queue_load_paths(controller->queue, paths, count));
+}
+
 int app_controller_enqueue_file(AppController *controller, const char *filepath)
 {
     if (!controller || !filepath)
@@ -99,7 +257,15 @@ int app_controller_enqueue_file(AppController *controller, const char *filepath)
     if (queue_enqueue(controller->queue, filepath) != 0)
         return -1;
 
-    if (!controller->player->is_playing)
+    if (!controller->measure_first)
+        loudness_scan(controller->loudness, filepath, 0);
+
+    if (controller->player->is_playing)
+    {
+        // The appended file may now be the one that follows the current track
+        app_controller_preload_next(controller);
+    }
+    else
     {
         int current = queue_get_current_index(controller->queue);
         if (current < 0)
@@ -114,6 +280,26 @@ int app_controller_enqueue_file(AppController *controller, const char *filepath)
     return 0;
 }
 
+int app_controller_poll_load(AppController *controller)
+{
+    if (!controller)
+        return 0;
+
+    switch (player_poll_load(controller->player))
+    {
+    case PLAYER_LOAD_STARTED:
+        app_controller_note_duration(controller);
+        app_controller_preload_next(controller);
+        return 1;
+    case PLAYER_LOAD_FAILED:
+        queue_clear_current(controller->queue);
+        return -1;
+    case PLAYER_LOAD_NONE:
+    default:
+        return 0;
+    }
+}
+
 int app_controller_handle_track_end(AppController *controller)
 {
     if (!controller)
@@ -214,7 +400,9 @@ int app_controller_toggle_shuffle(AppController *controller)
     if (!controller || !controller->queue)
         return 0;
 
-    return queue_toggle_shuffle(controller->queue);
+    int enabled = queue_toggle_shuffle(controller->queue);
+    app_controller_preload_next(controller);
+    return enabled;
 }
 
 int app_controller_get_shuffle(const AppController *controller)
@@ -233,7 +421,9 @@ QueueRepeatMode app_controller_cycle_repeat(AppController *controller)
     // Repeat mode is always controller/queue-driven.
     // Keep low-level sound looping disabled; replay is handled on track end.
     player_set_loop(controller->player, 0);
-    return queue_cycle_repeat_mode(controller->queue);
+    QueueRepeatMode mode = queue_cycle_repeat_mode(controller->queue);
+    app_controller_preload_next(controller);
+    return mode;
 }
 
 const char *app_controller_get_repeat_label(const AppController *controller)
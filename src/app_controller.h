@@ -9,11 +9,16 @@
 
 #include "player.h"
 #include "queue.h"
+#include "library.h"
+#include "loudness.h"
 
 typedef struct AppController
 {
     Player *player;
     Queue *queue;
+    Library *library; // Persistent folder index, NULL if unavailable
+    Loudness *loudness; // Loudness scanner, NULL if loudness=0 or unavailable
+    int measure_first;  // 1 to measure each track before it loads instead of in the background
 } AppController;
 
 /**
@@ -23,13 +28,26 @@ typedef struct AppController
 AppController *app_controller_create(Player *player);
 void app_controller_destroy(AppController *controller);
 
+/**
+ * Measure each track's loudness on the calling thread right before it loads,
+ * instead of in the background, so its gain never depends on scan timing.
+ * Set it before loading anything; meant for offline renders.
+ */
+void app_controller_set_measure_first(AppController *controller, int enabled);
+
 /**
  * Access queue state.
  */
 const Queue *app_controller_get_queue(const AppController *controller);
 
+/**
+ * Access the library index (may be NULL).
+ */
+Library *app_controller_get_library(const AppController *controller);
+
 /**
  * Start playback immediately with a single file and reset queue to that file.
+ * The file is loaded in the background; see app_controller_poll_load().
  * Returns 0 on success, -1 on failure.
  */
 int app_controller_play_file_now(AppController *controller, const char *filepath);
@@ -40,6 +58,13 @@ int app_controller_play_file_now(AppController *controller, const char *filepath
  */
 int app_controller_load_playlist_folder(AppController *controller, const char *folderpath);
 
+/**
+ * Replace the queue with the given files, in order, and start playback the
+ * way a folder load does.
+ * Returns number of loaded tracks on success, -1 on failure.
+ */
+int app_controller_load_playlist(AppController *controller, const char *const *paths, size_t count);
+
 /**
  * Add one file to queue.
  * If nothing is currently playing, starts playback from first queued item.
@@ -47,6 +72,14 @@ int app_controller_load_playlist_folder(AppController *controller, const char *f
  */
 int app_controller_enqueue_file(AppController *controller, const char *filepath);
 
+/**
+ * Finish a background track load once the player's event descriptor fired.
+ * Starts preloading the following track when the load succeeded.
+ * Returns 1 if a track started, 0 if nothing changed, -1 if loading failed
+ * (playback is stopped).
+ */
+int app_controller_poll_load(AppController *controller);
+
 /**
  * Handle track-end transition according to queue repeat mode.
  * Returns 1 if playback continues with another track, 0 if playback stops,
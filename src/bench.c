@@ -0,0 +1,422 @@
+/**
+ * bench.c - Built-in benchmarks implementation
+ *
+ * Inputs are generated up front so only the code under test is timed.
+ * Timings use the monotonic clock and are averaged over several cycles.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include "bench.h"
+#include "queue.h"
+#include "player.h"
+#include "loudness.h"
+#include "ui_core.h"
+#include "ui_screens.h"
+#include "util.h"
+
+#define BENCH_QUEUE_CYCLES 10
+#define BENCH_STARTUP_TIMEOUT_MS 10000.0 // Give up on a load or on audio after this
+#define BENCH_LOUDNESS_CYCLES 3
+#define BENCH_SEEK_COUNT 20
+#define BENCH_SEEK_INDEX_WAIT_MS 5000.0 // Longest wait for the seek index before seeking anyway
+
+// Milestones of one cold start, in ms since player_create()
+typedef struct BenchStartup
+{
+    double frame_ms;  // Welcome screen built
+    double engine_ms; // Audio engine and device ready
+    double audio_ms;  // First frame of the file played, or -1 without a file
+} BenchStartup;
+
+/**
+ * Build paths shaped like a music library: /music/Artist/Album/NN Track.mp3
+ */
+static char **bench_make_paths(size_t count)
+{
+    char **paths = (char **)malloc(count * sizeof(char *));
+    if (!paths)
+        return NULL;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        char path[128];
+        snprintf(path, sizeof(path), "/music/Artist %04zu/Album %02zu/%02zu Track number %zu.mp3",
+                 i / 200, (i / 12) % 17, i % 12 + 1, i);
+
+        paths[i] = (char *)malloc(strlen(path) + 1);
+        if (!paths[i])
+        {
+            while (i > 0)
+                free(paths[--i]);
+            free(paths);
+            return NULL;
+        }
+        strcpy(paths[i], path);
+    }
+
+    return paths;
+}
+
+int bench_queue(size_t path_count)
+{
+    if (path_count == 0)
+        return -1;
+
+    char **paths = bench_make_paths(path_count);
+    Queue *queue = queue_create();
+    char **copies = (char **)malloc(path_count * sizeof(char *));
+    if (!paths || !queue || !copies)
+    {
+        fprintf(stderr, "bench: out of memory\n");
+        free(copies);
+        queue_destroy(queue);
+        return -1;
+    }
+
+    double load_ms = 0.0;
+    double batch_ms = 0.0;
+    double clear_ms = 0.0;
+    double malloc_load_ms = 0.0;
+    double malloc_clear_ms = 0.0;
+    int result = 0;
+
+    for (int cycle = 0; cycle < BENCH_QUEUE_CYCLES && result == 0; cycle++)
+    {
+        double start = util_time_ms();
+        for (size_t i = 0; i < path_count; i++)
+        {
+            if (queue_enqueue(queue, paths[i]) != 0)
+            {
+                result = -1;
+                break;
+            }
+        }
+        double loaded = util_time_ms();
+        queue_clear(queue);
+        double cleared = util_time_ms();
+
+        load_ms += loaded - start;
+        clear_ms += cleared - loaded;
+
+        start = util_time_ms();
+        if (queue_enqueue_batch(queue, (const char *const *)paths, path_count) != (int)path_count)
+        {
+            result = -1;
+            break;
+        }
+        batch_ms += util_time_ms() - start;
+        queue_clear(queue);
+
+        // Baseline: what enqueue did before the arena, one heap copy per
+        // path freed one by one on clear
+        start = util_time_ms();
+        for (size_t i = 0; i < path_count; i++)
+        {
+            copies[i] = NULL;
+            if (!queue_is_audio_file(paths[i]))
+                continue;
+
+            size_t len = strlen(paths[i]) + 1;
+            copies[i] = (char *)malloc(len);
+            if (copies[i])
+                memcpy(copies[i], paths[i], len);
+        }
+        loaded = util_time_ms();
+        for (size_t i = 0; i < path_count; i++)
+            free(copies[i]);
+        cleared = util_time_ms();
+
+        malloc_load_ms += loaded - start;
+        malloc_clear_ms += cleared - loaded;
+    }
+
+    if (result == 0)
+    {
+        printf("Queue load/clear: %zu paths, %d cycles\n", path_count, BENCH_QUEUE_CYCLES);
+        printf("  arena:  load %8.3f ms (%6.1f ns/path), clear %8.3f ms\n",
+               load_ms / BENCH_QUEUE_CYCLES, load_ms * 1e6 / BENCH_QUEUE_CYCLES / path_count,
+               clear_ms / BENCH_QUEUE_CYCLES);
+        printf("  batch:  load %8.3f ms (%6.1f ns/path)\n",
+               batch_ms / BENCH_QUEUE_CYCLES, batch_ms * 1e6 / BENCH_QUEUE_CYCLES / path_count);
+        printf("  malloc: load %8.3f ms (%6.1f ns/path), free  %8.3f ms\n",
+               malloc_load_ms / BENCH_QUEUE_CYCLES, malloc_load_ms * 1e6 / BENCH_QUEUE_CYCLES / path_count,
+               malloc_clear_ms / BENCH_QUEUE_CYCLES);
+        printf("Peak memory: %.1f MB\n", util_peak_memory_kb() / 1024.0);
+    }
+    else
+    {
+        fprintf(stderr, "bench: enqueue failed\n");
+    }
+
+    for (size_t i = 0; i < path_count; i++)
+        free(paths[i]);
+    free(paths);
+    free(copies);
+    queue_destroy(queue);
+    return result;
+}
+
+/**
+ * Wait for a background load to finish
+ * Returns 0 once the track started, -1 on failure or timeout
+ */
+static int bench_wait_load(Player *player, double start)
+{
+    struct pollfd fd = {player_get_event_fd(player), POLLIN, 0};
+
+    while (util_time_ms() - start < BENCH_STARTUP_TIMEOUT_MS)
+    {
+        if (poll(&fd, 1, 100) <= 0)
+            continue;
+
+        player_drain_events(player);
+        PlayerLoadResult result = player_poll_load(player);
+        if (result == PLAYER_LOAD_STARTED)
+            return 0;
+        if (result == PLAYER_LOAD_FAILED)
+            return -1;
+    }
+
+    return -1;
+}
+
+/**
+ * Wait until the audio thread reports the current track moving
+ * Returns 0 on success, -1 on timeout
+ */
+static int bench_wait_audio(Player *player, double start)
+{
+    while (util_time_ms() - start < BENCH_STARTUP_TIMEOUT_MS)
+    {
+        PlayerTelemetry telemetry;
+        player_get_telemetry(player, &telemetry);
+        if (telemetry.sample_rate > 0 && telemetry.cursor > 0)
+            return 0;
+
+        usleep(100);
+    }
+
+    return -1;
+}
+
+/**
+ * One cold start
+ * eager: 1 to wait for the engine before building the first frame
+ */
+static int bench_startup_run(const char *filepath, int eager, BenchStartup *out)
+{
+    double start = util_time_ms();
+    Player *player = player_create();
+    if (!player)
+        return -1;
+
+    int result = 0;
+    if (eager)
+    {
+        result = player_wait_ready(player);
+        out->engine_ms = util_time_ms() - start;
+    }
+
+    // Built like the real welcome screen, but not written to the terminal
+    UIBuffer *buf = ui_buffer_create();
+    if (buf)
+        ui_screen_welcome(buf, 0, "", "", "");
+    out->frame_ms = util_time_ms() - start;
+    ui_buffer_destroy(buf);
+
+    // The play request goes out before the engine is ready, as when a file
+    // is given on the command line
+    if (result == 0 && filepath && player_play_async(player, filepath) != 0)
+        result = -1;
+
+    if (result == 0 && !eager)
+    {
+        result = player_wait_ready(player);
+        out->engine_ms = util_time_ms() - start;
+    }
+
+    out->audio_ms = -1.0;
+    if (result == 0 && filepath)
+    {
+        result = bench_wait_load(player, start) == 0 ? bench_wait_audio(player, start) : -1;
+        out->audio_ms = util_time_ms() - start;
+    }
+
+    player_destroy(player);
+    return result;
+}
+
+/**
+ * Print one run's milestones
+ */
+static void bench_startup_print(const char *label, const BenchStartup *run)
+{
+    printf("  %-28s first frame %8.2f ms, engine ready %8.2f ms", label, run->frame_ms, run->engine_ms);
+    if (run->audio_ms >= 0.0)
+        printf(", first audio %8.2f ms", run->audio_ms);
+    printf("\n");
+}
+
+int bench_startup(const char *filepath)
+{
+    BenchStartup lazy = {0};
+    BenchStartup eager = {0};
+
+    if (bench_startup_run(filepath, 0, &lazy) != 0 || bench_startup_run(filepath, 1, &eager) != 0)
+    {
+        fprintf(stderr, "bench: %s\n", filepath ? "could not play file" : "audio engine unavailable");
+        return -1;
+    }
+
+    printf("Startup%s%s\n", filepath ? ": " : "", filepath ? filepath : "");
+    bench_startup_print("engine in background:", &lazy);
+    bench_startup_print("engine before first frame:", &eager);
+    return 0;
+}
+
+int bench_loudness(const char *filepath)
+{
+    if (!filepath)
+    {
+        fprintf(stderr, "bench: --bench-loudness needs a file\n");
+        return -1;
+    }
+
+    LoudnessResult result;
+    double best_ms = 0.0;
+
+    for (int cycle = 0; cycle < BENCH_LOUDNESS_CYCLES; cycle++)
+    {
+        double start = util_time_ms();
+        if (loudness_analyze_file(filepath, &result) != 0)
+        {
+            fprintf(stderr, "bench: could not decode %s\n", filepath);
+            return -1;
+        }
+
+        double elapsed = util_time_ms() - start;
+        if (cycle == 0 || elapsed < best_ms)
+            best_ms = elapsed;
+    }
+
+    printf("Loudness: %s\n", filepath);
+    printf("  integrated: %.1f LUFS, true peak %.1f dBTP, %.1f s\n", result.loudness, result.peak, result.seconds);
+    printf("  scan: %.2f ms best of %d (%.0fx real time)\n", best_ms, BENCH_LOUDNESS_CYCLES,
+           best_ms > 0.0 ? result.seconds * 1000.0 / best_ms : 0.0);
+    return 0;
+}
+
+/**
+ * Wait until the audio thread plays from a seek target
+ * Returns the time taken in ms, or -1 on timeout
+ */
+static double bench_wait_seek(Player *player, double target, double start)
+{
+    while (util_time_ms() - start < BENCH_STARTUP_TIMEOUT_MS)
+    {
+        PlayerTelemetry telemetry;
+        player_get_telemetry(player, &telemetry);
+        if (telemetry.sample_rate > 0)
+        {
+            double position = (double)telemetry.cursor / telemetry.sample_rate;
+            if (position > target && position < target + 1.0)
+                return util_time_ms() - start;
+        }
+
+        usleep(100);
+    }
+
+    return -1.0;
+}
+
+int bench_seek(const char *filepath)
+{
+    if (!filepath)
+    {
+        fprintf(stderr, "bench: --bench-seek needs a file\n");
+        return -1;
+    }
+
+    Player *player = player_create();
+    if (!player)
+        return -1;
+
+    double start = util_time_ms();
+    if (player_play_async(player, filepath) != 0 || bench_wait_load(player, start) != 0 ||
+        bench_wait_audio(player, start) != 0)
+    {
+        fprintf(stderr, "bench: could not play %s\n", filepath);
+        player_destroy(player);
+        return -1;
+    }
+
+    // MP3s get their index in the background; other formats never do
+    PlayerStats stats;
+    double index_start = util_time_ms();
+    do
+    {
+        player_get_stats(player, &stats);
+        if (stats.seek_indexes_built + stats.seek_indexes_loaded > 0)
+            break;
+        usleep(10000);
+    } while (util_time_ms() - index_start < BENCH_SEEK_INDEX_WAIT_MS);
+    double index_ms = util_time_ms() - index_start;
+
+    float duration = player_get_duration(player);
+    PlayerTelemetry before;
+    player_get_telemetry(player, &before);
+
+    double min_ms = 0.0;
+    double max_ms = 0.0;
+    double total_ms = 0.0;
+    int done = 0;
+    unsigned int seed = 12345;
+
+    for (int i = 0; i < BENCH_SEEK_COUNT && duration > 2.0f; i++)
+    {
+        // Fixed pseudo-random targets, away from both ends
+        seed = seed * 1103515245u + 12345u;
+        double target = duration * (0.05 + 0.9 * ((seed >> 8) & 0xFFFF) / 65536.0);
+
+        double seek_start = util_time_ms();
+        if (player_seek(player, (float)target) != 0)
+            break;
+
+        double elapsed = bench_wait_seek(player, target, seek_start);
+        if (elapsed < 0.0)
+            break;
+
+        if (done == 0 || elapsed < min_ms)
+            min_ms = elapsed;
+        if (elapsed > max_ms)
+            max_ms = elapsed;
+        total_ms += elapsed;
+        done++;
+    }
+
+    PlayerTelemetry after;
+    player_get_telemetry(player, &after);
+    player_get_stats(player, &stats);
+    player_destroy(player);
+
+    if (done < BENCH_SEEK_COUNT)
+    {
+        fprintf(stderr, "bench: %s\n", duration > 2.0f ? "a seek took over 10 s" : "file is too short to seek");
+        return -1;
+    }
+
+    printf("Seek: %s (%.1f s)\n", filepath, duration);
+    if (stats.seek_indexes_built + stats.seek_indexes_loaded > 0)
+        printf("  index: %s after %.0f ms\n", stats.seek_indexes_loaded > 0 ? "read from disk" : "built", index_ms);
+    else
+        printf("  index: none\n");
+    printf("  %d seeks: %.2f ms min, %.2f ms avg, %.2f ms max until audio resumed\n",
+           done, min_ms, total_ms / done, max_ms);
+    printf("  audio callbacks: %.0f us max, %llu underruns during seeks\n",
+           after.callback_max_us, after.underruns - before.underruns);
+    return 0;
+}
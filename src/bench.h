@@ -0,0 +1,48 @@
+/**
+ * bench.h - Built-in benchmarks
+ *
+ * Micro-benchmarks for hot paths, run from the command line
+ * (e.g. walcman --bench-queue) and printed as plain text.
+ */
+
+#ifndef WALCMAN_BENCH_H
+#define WALCMAN_BENCH_H
+
+#include <stddef.h>
+
+/**
+ * Time repeated load/clear cycles of a queue of synthetic paths, one
+ * enqueue at a time and as one batch, next to the same cycles with one
+ * malloc'd copy per path for comparison
+ * path_count: Paths per cycle
+ * Returns: 0 on success, -1 on failure
+ */
+int bench_queue(size_t path_count);
+
+/**
+ * Time a cold start: player creation to the first UI frame, to the audio
+ * engine being ready and to the first frame of a file reaching the output.
+ * Runs once with the engine initialized in the background and once waiting
+ * for it before the first frame, as startup used to.
+ * filepath: Audio file to play, or NULL to skip the audio measurement
+ * Returns: 0 on success, -1 on failure
+ */
+int bench_startup(const char *filepath);
+
+/**
+ * Measure a file's loudness and true peak several times and report the
+ * result with the scan speed as a multiple of real time
+ * filepath: Audio file
+ * Returns: 0 on success, -1 on failure
+ */
+int bench_loudness(const char *filepath);
+
+/**
+ * Play a file, give its seek index a few seconds to appear and time
+ * pseudo-random seeks until the output plays from each target
+ * filepath: Audio file, at least a few seconds long
+ * Returns: 0 on success, -1 on failure
+ */
+int bench_seek(const char *filepath);
+
+#endif // WALCMAN_BENCH_H
@@ -0,0 +1,142 @@
+/**
+ * config.c - User configuration lookup implementation
+ *
+ * Loads ~/.config/walcman/config into memory once and answers key lookups
+ * from the cached copy, so hot paths never touch the filesystem.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "config.h"
+
+#define CONFIG_DIR "/.config/walcman/"
+#define CONFIG_MAX_SIZE 65536 // Ignore anything beyond 64KB
+
+static char *config_text = NULL;
+static pthread_once_t config_once = PTHREAD_ONCE_INIT;
+
+static void config_load(void)
+{
+    char path[512];
+    if (config_path(path, sizeof(path), "config") != 0)
+        return;
+
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return;
+
+    char *text = (char *)malloc(CONFIG_MAX_SIZE + 1);
+    if (!text)
+    {
+        fclose(f);
+        return;
+    }
+
+    size_t len = fread(text, 1, CONFIG_MAX_SIZE, f);
+    fclose(f);
+
+    text[len] = '\0';
+    config_text = text;
+}
+
+/**
+ * Find the value of key in the cached config text
+ * Returns pointer to the first character after "key=", or NULL
+ */
+static const char *config_find(const char *key)
+{
+    pthread_once(&config_once, config_load);
+
+    if (!key || !config_text)
+        return NULL;
+
+    size_t key_len = strlen(key);
+    const char *line = config_text;
+
+    while (*line)
+    {
+        // Skip comments and empty lines
+        if (line[0] != '#' && line[0] != '\n' &&
+            strncmp(line, key, key_len) == 0 && line[key_len] == '=')
+        {
+            return line + key_len + 1;
+        }
+
+        const char *newline = strchr(line, '\n');
+        if (!newline)
+            break;
+        line = newline + 1;
+    }
+
+    return NULL;
+}
+
+long config_get_long(const char *key, long default_value)
+{
+    const char *value = config_find(key);
+    if (!value)
+        return default_value;
+
+    char *end = NULL;
+    long parsed = strtol(value, &end, 10);
+    if (end == value)
+        return default_value;
+
+    return parsed;
+}
+
+double config_get_double(const char *key, double default_value)
+{
+    const char *value = config_find(key);
+    if (!value)
+        return default_value;
+
+    char *end = NULL;
+    double parsed = strtod(value, &end);
+    if (end == value)
+        return default_value;
+
+    return parsed;
+}
+
+int config_path(char *out, size_t out_size, const char *name)
+{
+    if (!out || out_size == 0 || !name)
+        return -1;
+
+    const char *home = getenv("HOME");
+    if (!home)
+        return -1;
+
+    int written = snprintf(out, out_size, "%s%s%s", home, CONFIG_DIR, name);
+    if (written < 0 || (size_t)written >= out_size)
+        return -1;
+
+    return 0;
+}
+
+int config_ensure_dir(void)
+{
+    char path[512];
+    if (config_path(path, sizeof(path), "") != 0)
+        return -1;
+
+    // Create ~/.config first, then ~/.config/walcman
+    char *walcman_dir = strrchr(path, '/');
+    *walcman_dir = '\0';
+    char *config_dir = strrchr(path, '/');
+    *config_dir = '\0';
+
+    if (mkdir(path, 0755) != 0 && errno != EEXIST)
+        return -1;
+
+    *config_dir = '/';
+    if (mkdir(path, 0755) != 0 && errno != EEXIST)
+        return -1;
+
+    return 0;
+}
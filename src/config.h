@@ -0,0 +1,45 @@
+/**
+ * config.h - User configuration lookup
+ *
+ * Read-only access to numeric settings in ~/.config/walcman/config.
+ * The file uses one key=value pair per line; lines starting with '#'
+ * are comments. The file is read once on first lookup and cached.
+ */
+
+#ifndef WALCMAN_CONFIG_H
+#define WALCMAN_CONFIG_H
+
+#include <stddef.h>
+
+/**
+ * Get an integer setting
+ * key: Setting name (e.g. "stream_threshold_mb")
+ * default_value: Value returned when the key is missing or malformed
+ * Returns: Configured value, or default_value
+ */
+long config_get_long(const char *key, long default_value);
+
+/**
+ * Get a floating point setting
+ * key: Setting name
+ * default_value: Value returned when the key is missing or malformed
+ * Returns: Configured value, or default_value
+ */
+double config_get_double(const char *key, double default_value);
+
+/**
+ * Build the path of a file inside the walcman config directory
+ * out: Output buffer
+ * out_size: Output buffer size
+ * name: File name relative to ~/.config/walcman (e.g. "library.idx")
+ * Returns: 0 on success, -1 if HOME is unset or the path does not fit
+ */
+int config_path(char *out, size_t out_size, const char *name);
+
+/**
+ * Create ~/.config/walcman if it does not exist yet
+ * Returns: 0 if the directory exists afterwards, -1 otherwise
+ */
+int config_ensure_dir(void);
+
+#endif // WALCMAN_CONFIG_H
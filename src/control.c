@@ -0,0 +1,903 @@
+/**
+ * control.c - Unix socket control protocol implementation
+ *
+ * Every client has a fixed input buffer for the line being received and a
+ * growable output buffer for replies that did not fit into the socket.
+ * Clients are only polled for writing while they have pending output, so
+ * a connected but quiet client never wakes the main loop.
+ *
+ * Long replies (the queue listing) are produced in parts as the socket
+ * drains. Until a reply is out, the client's further commands wait in
+ * its buffer, so replies never interleave and a client that is slow to
+ * read holds up only itself.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "control.h"
+#include "config.h"
+
+#define CONTROL_LINE_MAX 4096           // Longest accepted command line
+#define CONTROL_OUTPUT_MAX (1024 * 1024) // Pending reply bytes before a client is dropped
+#define CONTROL_OUTPUT_HIGH (64 * 1024)  // Pending reply bytes before further commands wait
+#define CONTROL_BACKLOG 16
+
+typedef struct ControlClient
+{
+    int fd;
+    char in[CONTROL_LINE_MAX]; // Partial command line
+    size_t in_len;
+    char received[1024];       // Bytes read but not yet parsed
+    size_t received_len;
+    size_t received_pos;
+    int discarding;            // 1 while skipping the rest of an overlong line
+    char *out;                 // Reply bytes not yet written
+    size_t out_len;
+    size_t out_sent;
+    size_t out_capacity;
+    int closing;               // 1 to disconnect once out is flushed
+    int broken;                // 1 once replies are being thrown away
+    int listing;               // 1 while a queue listing is being sent
+    size_t list_next;          // Queue index the listing continues at
+    char **staged;             // Files collected by stage, played by start
+    size_t staged_count;
+    size_t staged_capacity;
+} ControlClient;
+
+struct ControlServer
+{
+    AppController *controller;
+    int listen_fd;
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    ControlClient *clients;
+    size_t client_count;
+    size_t client_capacity;
+    int shutdown_requested;
+};
+
+// A command handler appends data lines and returns NULL, or returns an error reason
+typedef const char *(*ControlHandler)(ControlServer *server, ControlClient *client, const char *arg);
+
+typedef struct ControlCommand
+{
+    const char *name;
+    int takes_arg;
+    ControlHandler run;
+    const char *help;
+} ControlCommand;
+
+// ===== Client output =====
+
+static void control_client_append(ControlClient *client, const char *data, size_t len)
+{
+    if (client->broken)
+        return;
+
+    if (client->out_len + len > CONTROL_OUTPUT_MAX)
+    {
+        // Not reading its replies; give up on it
+        client->out_len = client->out_sent = 0;
+        client->closing = 1;
+        client->broken = 1;
+        return;
+    }
+
+    if (client->out_len + len > client->out_capacity)
+    {
+        size_t capacity = client->out_capacity ? client->out_capacity : 1024;
+        while (capacity < client->out_len + len)
+            capacity *= 2;
+
+        char *grown = (char *)realloc(client->out, capacity);
+        if (!grown)
+        {
+            client->closing = 1;
+            client->broken = 1;
+            return;
+        }
+        client->out = grown;
+        client->out_capacity = capacity;
+    }
+
+    memcpy(client->out + client->out_len, data, len);
+    client->out_len += len;
+}
+
+static void control_client_printf(ControlClient *client, const char *format, ...)
+{
+    char line[CONTROL_LINE_MAX + 64];
+    va_list args;
+
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (len < 0)
+        return;
+    if ((size_t)len >= sizeof(line))
+        len = (int)sizeof(line) - 1;
+
+    control_client_append(client, line, (size_t)len);
+}
+
+/**
+ * Check whether earlier replies still hold up the client's next command
+ */
+static int control_client_busy(const ControlClient *client)
+{
+    return client->listing || client->out_len - client->out_sent >= CONTROL_OUTPUT_HIGH;
+}
+
+/**
+ * Append the next part of a queue listing, and OK once it is complete.
+ * Tracks added or removed meanwhile are listed as the queue is by then.
+ */
+static void control_client_continue(ControlServer *server, ControlClient *client)
+{
+    const Queue *queue = app_controller_get_queue(server->controller);
+    size_t count = queue_count(queue);
+
+    while (client->list_next < count && client->out_len < CONTROL_OUTPUT_HIGH && !client->broken)
+    {
+        control_client_printf(client, "%zu %s\n", client->list_next + 1, queue_get_item(queue, client->list_next));
+        client->list_next++;
+    }
+
+    if (client->list_next >= count)
+    {
+        client->listing = 0;
+        control_client_append(client, "OK\n", 3);
+    }
+}
+
+/**
+ * Write as much pending output as the socket takes, continuing a listing
+ * whenever the previous part is out
+ * Returns: 0 if the client is still usable, -1 if it should be dropped
+ */
+static int control_client_flush(ControlServer *server, ControlClient *client)
+{
+    for (;;)
+    {
+        while (client->out_sent < client->out_len)
+        {
+            ssize_t written = write(client->fd, client->out + client->out_sent, client->out_len - client->out_sent);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    return 0;
+                return -1;
+            }
+            client->out_sent += (size_t)written;
+        }
+
+        client->out_len = client->out_sent = 0;
+        if (!client->listing || client->broken)
+            break;
+
+        control_client_continue(server, client);
+    }
+
+    return client->closing ? -1 : 0;
+}
+
+// ===== Commands =====
+
+static const char *control_state_name(PlayerState state)
+{
+    switch (state)
+    {
+    case STATE_PLAYING:
+        return "playing";
+    case STATE_PAUSED:
+        return "paused";
+    case STATE_LOADING:
+        return "loading";
+    default:
+        return "stopped";
+    }
+}
+
+static const char *control_cmd_play(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)client;
+    struct stat st;
+
+    if (stat(arg, &st) != 0)
+        return "no such file or folder";
+
+    if (S_ISDIR(st.st_mode))
+        return app_controller_load_playlist_folder(server->controller, arg) > 0 ? NULL : "no playable files in folder";
+
+    return app_controller_play_file_now(server->controller, arg) == 0 ? NULL : "cannot play file";
+}
+
+static const char *control_cmd_enqueue(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)client;
+    struct stat st;
+
+    if (stat(arg, &st) != 0)
+        return "no such file";
+    if (!S_ISREG(st.st_mode))
+        return "only files can be queued";
+
+    return app_controller_enqueue_file(server->controller, arg) == 0 ? NULL : "cannot queue file";
+}
+
+/**
+ * Forget the files a client staged
+ */
+static void control_client_unstage(ControlClient *client)
+{
+    for (size_t i = 0; i < client->staged_count; i++)
+        free(client->staged[i]);
+    free(client->staged);
+    client->staged = NULL;
+    client->staged_count = 0;
+    client->staged_capacity = 0;
+}
+
+static const char *control_cmd_stage(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)server;
+    struct stat st;
+
+    if (stat(arg, &st) != 0)
+        return "no such file";
+    if (!S_ISREG(st.st_mode))
+        return "only files can be staged";
+
+    if (client->staged_count == client->staged_capacity)
+    {
+        size_t capacity = client->staged_capacity ? client->staged_capacity * 2 : 64;
+        char **grown = (char **)realloc(client->staged, capacity * sizeof(char *));
+        if (!grown)
+            return "out of memory";
+        client->staged = grown;
+        client->staged_capacity = capacity;
+    }
+
+    size_t len = strlen(arg) + 1;
+    char *copy = (char *)malloc(len);
+    if (!copy)
+        return "out of memory";
+    memcpy(copy, arg, len);
+
+    client->staged[client->staged_count++] = copy;
+    return NULL;
+}
+
+static const char *control_cmd_start(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)arg;
+
+    if (client->staged_count == 0)
+        return "nothing staged";
+
+    int loaded = app_controller_load_playlist(server->controller, (const char *const *)client->staged,
+                                              client->staged_count);
+    control_client_unstage(client);
+    return loaded > 0 ? NULL : "no playable files staged";
+}
+
+static const char *control_cmd_pause(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)client;
+    (void)arg;
+
+    Player *player = server->controller->player;
+    if (!player->is_playing)
+        return "nothing is playing";
+
+    player_pause(player);
+    return NULL;
+}
+
+static const char *control_cmd_resume(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)client;
+    (void)arg;
+
+    Player *player = server->controller->player;
+    if (!player->is_playing)
+        return "nothing is playing";
+
+    player_resume(player);
+    return NULL;
+}
+
+static const char *control_cmd_toggle(ControlServer *server, ControlClient *client, const char *arg)
+{
+    Player *player = server->controller->player;
+    if (player->is_playing && player->is_paused)
+        return control_cmd_resume(server, client, arg);
+
+    return control_cmd_pause(server, client, arg);
+}
+
+static const char *control_cmd_stop(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)client;
+    (void)arg;
+
+    player_stop(server->controller->player);
+    return NULL;
+}
+
+static const char *control_cmd_next(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)client;
+    (void)arg;
+
+    return app_controller_play_next(server->controller) < 0 ? "cannot play next track" : NULL;
+}
+
+static const char *control_cmd_prev(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)client;
+    (void)arg;
+
+    int result = app_controller_play_previous(server->controller);
+    if (result == 0)
+        return "no previous track";
+    return result < 0 ? "cannot play previous track" : NULL;
+}
+
+static const char *control_cmd_seek(ControlServer *server, ControlClient *client, const char *arg)
+{
+    Player *player = server->controller->player;
+    if (!player->is_playing)
+        return "nothing is playing";
+
+    // "+N" and "-N" are relative to the current position, "N" is absolute
+    char *end = NULL;
+    double seconds = strtod(arg, &end);
+    if (end == arg || *end != '\0')
+        return "invalid position";
+    if (arg[0] == '+' || arg[0] == '-')
+        seconds += player_get_position(player);
+
+    if (player_seek(player, (float)seconds) != 0)
+        return "cannot seek";
+
+    control_client_printf(client, "position %.1f\n", player_get_position(player));
+    return NULL;
+}
+
+static const char *control_cmd_repeat(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)arg;
+
+    app_controller_cycle_repeat(server->controller);
+    control_client_printf(client, "repeat %s\n", app_controller_get_repeat_label(server->controller));
+    return NULL;
+}
+
+static const char *control_cmd_shuffle(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)arg;
+
+    int enabled = app_controller_toggle_shuffle(server->controller);
+    control_client_printf(client, "shuffle %s\n", enabled ? "on" : "off");
+    return NULL;
+}
+
+static const char *control_cmd_status(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)arg;
+
+    AppController *controller = server->controller;
+    Player *player = controller->player;
+    const Queue *queue = app_controller_get_queue(controller);
+    const char *file = player_get_current_file(player);
+
+    control_client_printf(client, "state %s\n", control_state_name(player_get_state(player)));
+    control_client_printf(client, "file %s\n", file ? file : "");
+    control_client_printf(client, "position %.1f\n", player_get_position(player));
+    control_client_printf(client, "duration %.1f\n", player_get_duration(player));
+    control_client_printf(client, "track %d/%zu\n", queue_get_current_index(queue) + 1, queue_count(queue));
+    control_client_printf(client, "repeat %s\n", app_controller_get_repeat_label(controller));
+    control_client_printf(client, "shuffle %s\n", app_controller_get_shuffle(controller) ? "on" : "off");
+    return NULL;
+}
+
+static const char *control_cmd_queue(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)server;
+    (void)arg;
+
+    // Sent in parts by control_client_flush(), which also adds the OK
+    client->listing = 1;
+    client->list_next = 0;
+    return NULL;
+}
+
+static const char *control_cmd_help(ControlServer *server, ControlClient *client, const char *arg);
+
+static const char *control_cmd_close(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)server;
+    (void)arg;
+
+    client->closing = 1;
+    return NULL;
+}
+
+static const char *control_cmd_shutdown(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)client;
+    (void)arg;
+
+    server->shutdown_requested = 1;
+    return NULL;
+}
+
+static const ControlCommand control_commands[] = {
+    {"play", 1, control_cmd_play, "play <path>     Play a file or load a folder"},
+    {"enqueue", 1, control_cmd_enqueue, "enqueue <path>  Add a file to the queue"},
+    {"stage", 1, control_cmd_stage, "stage <path>    Collect a file for start"},
+    {"start", 0, control_cmd_start, "start           Replace the queue with the staged files and play"},
+    {"pause", 0, control_cmd_pause, "pause           Pause playback"},
+    {"resume", 0, control_cmd_resume, "resume          Resume playback"},
+    {"toggle", 0, control_cmd_toggle, "toggle          Pause or resume"},
+    {"stop", 0, control_cmd_stop, "stop            Stop playback"},
+    {"next", 0, control_cmd_next, "next            Next track"},
+    {"prev", 0, control_cmd_prev, "prev            Previous track"},
+    {"seek", 1, control_cmd_seek, "seek <seconds>  Jump to a position (+N/-N: relative)"},
+    {"repeat", 0, control_cmd_repeat, "repeat          Cycle repeat mode"},
+    {"shuffle", 0, control_cmd_shuffle, "shuffle         Toggle shuffle"},
+    {"status", 0, control_cmd_status, "status          Playback status"},
+    {"queue", 0, control_cmd_queue, "queue           List queued tracks"},
+    {"help", 0, control_cmd_help, "help            This list"},
+    {"close", 0, control_cmd_close, "close           End the connection"},
+    {"shutdown", 0, control_cmd_shutdown, "shutdown        Stop walcman"},
+};
+
+#define CONTROL_COMMAND_COUNT (sizeof(control_commands) / sizeof(control_commands[0]))
+
+static const char *control_cmd_help(ControlServer *server, ControlClient *client, const char *arg)
+{
+    (void)server;
+    (void)arg;
+
+    for (size_t i = 0; i < CONTROL_COMMAND_COUNT; i++)
+        control_client_printf(client, "%s\n", control_commands[i].help);
+    return NULL;
+}
+
+/**
+ * Run one command line and append its reply
+ */
+static void control_execute(ControlServer *server, ControlClient *client, char *line)
+{
+    char *name = line;
+    while (*name == ' ' || *name == '\t')
+        name++;
+
+    if (*name == '\0')
+        return;
+
+    char *arg = name;
+    while (*arg && *arg != ' ' && *arg != '\t')
+        arg++;
+    if (*arg)
+    {
+        *arg++ = '\0';
+        while (*arg == ' ' || *arg == '\t')
+            arg++;
+    }
+
+    for (size_t i = 0; i < CONTROL_COMMAND_COUNT; i++)
+    {
+        const ControlCommand *command = &control_commands[i];
+        if (strcmp(command->name, name) != 0)
+            continue;
+
+        if (command->takes_arg && *arg == '\0')
+        {
+            control_client_printf(client, "ERR %s needs an argument\n", name);
+            return;
+        }
+
+        const char *error = command->run(server, client, arg);
+        if (error)
+            control_client_printf(client, "ERR %s\n", error);
+        else if (!client->listing)
+            control_client_append(client, "OK\n", 3);
+        return;
+    }
+
+    control_client_printf(client, "ERR unknown command %s\n", name);
+}
+
+// ===== Connections =====
+
+/**
+ * Read what the client sent and run every complete line. Nothing after a
+ * close is run, and while a reply is held up the rest stays buffered.
+ * End of input only marks the client as closing, so replies still get flushed.
+ * Returns: 0 if the client is still usable, -1 on a read error
+ */
+static int control_client_read(ControlServer *server, ControlClient *client)
+{
+    for (;;)
+    {
+        if (client->closing || control_client_busy(client))
+            return 0;
+
+        if (client->received_pos == client->received_len)
+        {
+            ssize_t got = read(client->fd, client->received, sizeof(client->received));
+            if (got == 0)
+            {
+                client->closing = 1;
+                return 0;
+            }
+            if (got < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+            }
+            client->received_len = (size_t)got;
+            client->received_pos = 0;
+        }
+
+        while (client->received_pos < client->received_len && !client->closing && !control_client_busy(client))
+        {
+            char ch = client->received[client->received_pos++];
+
+            if (ch == '\n')
+            {
+                if (client->discarding)
+                {
+                    control_client_append(client, "ERR line too long\n", 18);
+                    client->discarding = 0;
+                }
+                else
+                {
+                    if (client->in_len > 0 && client->in[client->in_len - 1] == '\r')
+                        client->in_len--;
+                    client->in[client->in_len] = '\0';
+                    control_execute(server, client, client->in);
+                }
+                client->in_len = 0;
+            }
+            else if (!client->discarding)
+            {
+                if (client->in_len + 1 < CONTROL_LINE_MAX)
+                    client->in[client->in_len++] = ch;
+                else
+                    client->discarding = 1;
+            }
+        }
+    }
+}
+
+static void control_client_drop(ControlServer *server, size_t index)
+{
+    ControlClient *client = &server->clients[index];
+    close(client->fd);
+    free(client->out);
+    control_client_unstage(client);
+
+    server->clients[index] = server->clients[server->client_count - 1];
+    server->client_count--;
+}
+
+static void control_accept(ControlServer *server)
+{
+    for (;;)
+    {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        if (server->client_count == server->client_capacity)
+        {
+            size_t capacity = server->client_capacity ? server->client_capacity * 2 : 4;
+            ControlClient *grown = (ControlClient *)realloc(server->clients, capacity * sizeof(ControlClient));
+            if (!grown)
+            {
+                close(fd);
+                continue;
+            }
+            server->clients = grown;
+            server->client_capacity = capacity;
+        }
+
+        ControlClient *client = &server->clients[server->client_count++];
+        memset(client, 0, sizeof(*client));
+        client->fd = fd;
+    }
+}
+
+// ===== Public API =====
+
+int control_socket_path(char *out, size_t out_size)
+{
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+    if (!out || out_size == 0)
+        return -1;
+
+    if (config_path(path, sizeof(path), "walcman.sock") != 0)
+        return -1;
+
+    if (strlen(path) >= out_size)
+        return -1;
+
+    strcpy(out, path);
+    return 0;
+}
+
+ControlServer *control_server_open(AppController *controller, const char *path)
+{
+    if (!controller)
+        return NULL;
+
+    ControlServer *server = (ControlServer *)calloc(1, sizeof(ControlServer));
+    if (!server)
+        return NULL;
+
+    server->controller = controller;
+    server->listen_fd = -1;
+
+    if (path)
+    {
+        if (strlen(path) >= sizeof(server->path))
+        {
+            free(server);
+            return NULL;
+        }
+        strcpy(server->path, path);
+    }
+    else if (config_ensure_dir() != 0 || control_socket_path(server->path, sizeof(server->path)) != 0)
+    {
+        free(server);
+        return NULL;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, server->path);
+
+    // A socket file nobody answers on is left over from an instance that died
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0)
+    {
+        int alive = connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        close(probe);
+        if (alive)
+        {
+            free(server);
+            return NULL;
+        }
+    }
+    unlink(server->path);
+
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server->listen_fd < 0 ||
+        bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server->listen_fd, CONTROL_BACKLOG) != 0)
+    {
+        if (server->listen_fd >= 0)
+            close(server->listen_fd);
+        free(server);
+        return NULL;
+    }
+
+    // Only the owner may control playback
+    chmod(server->path, S_IRUSR | S_IWUSR);
+    fcntl(server->listen_fd, F_SETFL, fcntl(server->listen_fd, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(server->listen_fd, F_SETFD, FD_CLOEXEC);
+
+    // A client that hangs up mid-reply must not take the player down with it
+    signal(SIGPIPE, SIG_IGN);
+
+    return server;
+}
+
+void control_server_close(ControlServer *server)
+{
+    if (!server)
+        return;
+
+    while (server->client_count > 0)
+        control_client_drop(server, server->client_count - 1);
+    free(server->clients);
+
+    if (server->listen_fd >= 0)
+    {
+        close(server->listen_fd);
+        unlink(server->path);
+    }
+
+    free(server);
+}
+
+size_t control_server_pollfd_count(const ControlServer *server)
+{
+    return server ? server->client_count + 1 : 0;
+}
+
+size_t control_server_fill_pollfds(const ControlServer *server, struct pollfd *fds, size_t max)
+{
+    if (!server || !fds || max == 0)
+        return 0;
+
+    fds[0].fd = server->listen_fd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+
+    size_t count = 1;
+    for (size_t i = 0; i < server->client_count && count < max; i++, count++)
+    {
+        const ControlClient *client = &server->clients[i];
+        fds[count].fd = client->fd;
+        // A closing client is only waited on until its replies are out, a
+        // busy one until there is room for the next part
+        int held = client->closing || control_client_busy(client);
+        short events = held ? 0 : POLLIN;
+        if (client->out_len > client->out_sent || client->listing)
+            events |= POLLOUT;
+        // Commands already buffered run as soon as the socket takes replies
+        if (!held && client->received_pos < client->received_len)
+            events |= POLLOUT;
+        fds[count].events = events;
+        fds[count].revents = 0;
+    }
+
+    return count;
+}
+
+int control_server_dispatch(ControlServer *server, const struct pollfd *fds, size_t count)
+{
+    if (!server || !fds || count == 0)
+        return 0;
+
+    // Clients first, from the back, so dropping one does not shift the others
+    size_t clients = count - 1 < server->client_count ? count - 1 : server->client_count;
+    for (size_t i = clients; i-- > 0;)
+    {
+        ControlClient *client = &server->clients[i];
+        short revents = fds[i + 1].revents;
+        int drop = 0;
+
+        if (revents & (POLLERR | POLLNVAL))
+            drop = 1;
+        else if (!client->closing && (revents & (POLLIN | POLLHUP | POLLOUT)) &&
+                 control_client_read(server, client) != 0)
+            drop = 1;
+
+        if (!drop && control_client_flush(server, client) != 0)
+            drop = 1;
+
+        if (drop)
+            control_client_drop(server, i);
+    }
+
+    if (fds[0].revents & POLLIN)
+        control_accept(server);
+
+    return server->shutdown_requested;
+}
+
+int control_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (path)
+    {
+        if (strlen(path) >= sizeof(addr.sun_path))
+            return -1;
+        strcpy(addr.sun_path, path);
+    }
+    else if (control_socket_path(addr.sun_path, sizeof(addr.sun_path)) != 0)
+    {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+int control_request(int fd, const char *command, char *error, size_t error_size)
+{
+    if (error && error_size > 0)
+        error[0] = '\0';
+
+    if (fd < 0 || !command)
+        return -1;
+
+    // The server may drop us at any time; don't die of SIGPIPE for it
+    signal(SIGPIPE, SIG_IGN);
+
+    size_t len = strlen(command);
+    const char *parts[2] = {command, "\n"};
+    size_t sizes[2] = {len, 1};
+
+    for (int i = 0; i < 2; i++)
+    {
+        size_t sent = 0;
+        while (sent < sizes[i])
+        {
+            ssize_t written = write(fd, parts[i] + sent, sizes[i] - sent);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return -1;
+            sent += (size_t)written;
+        }
+    }
+
+    // Replies are short; read a byte at a time so nothing past the final line is consumed
+    char line[CONTROL_LINE_MAX];
+    size_t line_len = 0;
+
+    for (;;)
+    {
+        char ch;
+        ssize_t got = read(fd, &ch, 1);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return -1;
+
+        if (ch != '\n')
+        {
+            if (line_len + 1 < sizeof(line))
+                line[line_len++] = ch;
+            continue;
+        }
+
+        line[line_len] = '\0';
+        line_len = 0;
+
+        if (strcmp(line, "OK") == 0)
+            return 0;
+
+        if (strncmp(line, "ERR", 3) == 0)
+        {
+            if (error && error_size > 0)
+            {
+                const char *reason = line[3] == ' ' ? line + 4 : line + 3;
+                strncpy(error, reason, error_size - 1);
+                error[error_size - 1] = '\0';
+            }
+            return -1;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+/**
+ * control.h - Unix socket control protocol
+ *
+ * Lets other processes drive a running walcman through
+ * ~/.config/walcman/walcman.sock: the --daemon mode, or an interactive
+ * instance receiving files from a second invocation. The protocol is line
+ * based: a client sends one command per line and gets zero or more data
+ * lines back, followed by "OK" or "ERR <reason>".
+ *
+ *   play <path>      Play a file, or load a folder as the playlist
+ *   enqueue <path>   Add a file to the queue
+ *   pause, resume, toggle, stop, next, prev
+ *   seek <seconds>   Jump to a position; "+N" and "-N" are relative
+ *   repeat           Cycle repeat mode
+ *   shuffle          Toggle shuffle
+ *   status           "key value" lines: state, file, position, duration, track, repeat, shuffle
+ *   queue            One "<number> <path>" line per queued track
+ *   help             List commands
+ *   close            End this connection
+ *   shutdown         Stop the daemon
+ *
+ * The server never blocks: sockets are non-blocking and served from the
+ * caller's poll() loop, so idle clients cost nothing and status requests
+ * only read state the audio thread already publishes.
+ */
+
+#ifndef WALCMAN_CONTROL_H
+#define WALCMAN_CONTROL_H
+
+#include <stddef.h>
+#include <poll.h>
+#include "app_controller.h"
+
+typedef struct ControlServer ControlServer;
+
+/**
+ * Build the default socket path (~/.config/walcman/walcman.sock)
+ * out: Output buffer
+ * out_size: Output buffer size
+ * Returns: 0 on success, -1 if the path is unavailable or too long
+ */
+int control_socket_path(char *out, size_t out_size);
+
+/**
+ * Start listening for control connections.
+ * A stale socket left by a crashed instance is replaced; a socket that
+ * still accepts connections means another instance is running.
+ * controller: Controller the commands act on
+ * path: Socket path, or NULL for the default
+ * Returns: Server instance, or NULL on failure (nothing is printed)
+ */
+ControlServer *control_server_open(AppController *controller, const char *path);
+
+/**
+ * Stop listening, disconnect clients and remove the socket file
+ * server: Server instance (may be NULL)
+ */
+void control_server_close(ControlServer *server);
+
+/**
+ * Get the number of descriptors control_server_fill_pollfds() writes
+ * server: Server instance
+ * Returns: Listener plus connected clients
+ */
+size_t control_server_pollfd_count(const ControlServer *server);
+
+/**
+ * Fill poll() entries for the listener and every client
+ * server: Server instance
+ * fds: Receives the entries
+ * max: Capacity of fds
+ * Returns: Number of entries written
+ */
+size_t control_server_fill_pollfds(const ControlServer *server, struct pollfd *fds, size_t max);
+
+/**
+ * Serve the descriptors poll() reported: accept clients, run complete
+ * command lines and flush pending replies
+ * server: Server instance
+ * fds: Entries from control_server_fill_pollfds(), after poll()
+ * count: Number of entries
+ * Returns: 1 if a client sent "shutdown", 0 otherwise
+ */
+int control_server_dispatch(ControlServer *server, const struct pollfd *fds, size_t count);
+
+/**
+ * Connect to the instance listening on a control socket
+ * path: Socket path, or NULL for the default
+ * Returns: Connected descriptor, or -1 if no instance is listening
+ */
+int control_connect(const char *path);
+
+/**
+ * Send one command and wait for its final reply line (data lines are skipped)
+ * fd: Descriptor from control_connect()
+ * command: Command line without the trailing newline
+ * error: Receives the reason after "ERR" (may be NULL)
+ * error_size: Size of error
+ * Returns: 0 on OK, -1 on ERR or a broken connection
+ */
+int control_request(int fd, const char *command, char *error, size_t error_size);
+
+#endif // WALCMAN_CONTROL_H
@@ -65,6 +65,25 @@ InputAction input_map_key(int ch)
     case 'q':
     case 'Q':
         return INPUT_ACTION_QUIT;
+    case 'j':
+    case 'J':
+        return INPUT_ACTION_SCROLL_DOWN;
+    case 'k':
+    case 'K':
+        return INPUT_ACTION_SCROLL_UP;
+    case 'd':
+    case 'D':
+        return INPUT_ACTION_PAGE_DOWN;
+    case 'u':
+    case 'U':
+        return INPUT_ACTION_PAGE_UP;
+    case 'g':
+    case 'G':
+        return INPUT_ACTION_SCROLL_CURRENT;
+    case ',':
+        return INPUT_ACTION_SEEK_BACK;
+    case '.':
+        return INPUT_ACTION_SEEK_FORWARD;
     default:
         return INPUT_ACTION_NONE;
     }
@@ -84,6 +103,9 @@ int input_prompt_path(UIBuffer *ui_buf, const char *prompt_text, char *out_path,
 
     int len = terminal_read_line(out_path, (int)out_size);
 
+    // The typed path was echoed outside the renderer
+    ui_invalidate();
+
     if (len > 0)
     {
         strip_quotes(out_path);
@@ -161,6 +183,16 @@ int input_handle_action(Player *player, InputAction action, UIBuffer *ui_buf, in
         }
         return 1;
 
+    case INPUT_ACTION_SEEK_BACK:
+    case INPUT_ACTION_SEEK_FORWARD:
+        // main.c redraws the screen with the new position
+        if (player->is_playing)
+        {
+            float step = action == INPUT_ACTION_SEEK_BACK ? -INPUT_SEEK_SECONDS : INPUT_SEEK_SECONDS;
+            player_seek(player, player_get_position(player) + step);
+        }
+        return 1;
+
     case INPUT_ACTION_SHOW_SETTINGS:
         ui_screen_settings(ui_buf);
         ui_buffer_render(ui_buf);
@@ -168,6 +200,11 @@ int input_handle_action(Player *player, InputAction action, UIBuffer *ui_buf, in
 
     case INPUT_ACTION_SELECT_COLOR:
     case INPUT_ACTION_BACK_TO_MAIN:
+    case INPUT_ACTION_SCROLL_DOWN:
+    case INPUT_ACTION_SCROLL_UP:
+    case INPUT_ACTION_PAGE_DOWN:
+    case INPUT_ACTION_PAGE_UP:
+    case INPUT_ACTION_SCROLL_CURRENT:
         // These are handled by main.c with its screen state
         return 1;
 
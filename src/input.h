@@ -16,6 +16,8 @@
 #include "ui_core.h"
 #include <stddef.h>
 
+#define INPUT_SEEK_SECONDS 10.0f // Step of the seek keys
+
 // Action codes returned by input handlers
 typedef enum
 {
@@ -34,7 +36,14 @@ typedef enum
     INPUT_ACTION_TOGGLE_LOOP,     // Toggle audio looping
     INPUT_ACTION_SHOW_SETTINGS,   // Open settings menu
     INPUT_ACTION_SELECT_COLOR,    // Enter color picker (submenu)
-    INPUT_ACTION_BACK_TO_MAIN     // Return to main screen
+    INPUT_ACTION_BACK_TO_MAIN,    // Return to main screen
+    INPUT_ACTION_SCROLL_DOWN,     // Scroll queue view down one row
+    INPUT_ACTION_SCROLL_UP,       // Scroll queue view up one row
+    INPUT_ACTION_PAGE_DOWN,       // Scroll queue view down half a page
+    INPUT_ACTION_PAGE_UP,         // Scroll queue view up half a page
+    INPUT_ACTION_SCROLL_CURRENT,  // Scroll queue view back to the current track
+    INPUT_ACTION_SEEK_BACK,       // Jump back INPUT_SEEK_SECONDS
+    INPUT_ACTION_SEEK_FORWARD     // Jump ahead INPUT_SEEK_SECONDS
 } InputAction;
 
 /**
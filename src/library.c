@@ -0,0 +1,769 @@
+/**
+ * library.c - Persistent library index implementation
+ *
+ * File layout (native byte order, every section 8-byte aligned up to the
+ * subdirectory table):
+ *
+ *   LibraryHeader
+ *   LibraryDirRecord  dirs[dir_count]     sorted by path (strcmp)
+ *   LibraryFileRecord files[file_count]   grouped by directory, sorted by name
+ *   uint32_t          subdirs[subdir_count] string offsets of subdirectory names
+ *   char              strings[string_size]  NUL-terminated strings
+ *
+ * The file is mapped read/write and shared, so lookups are plain memory
+ * reads and durations can be filled in place. Directories listed during a
+ * scan are collected in memory and merged into a new file on commit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "library.h"
+#include "config.h"
+
+#define LIBRARY_FILE "library.idx"
+#define LIBRARY_MAGIC "WLIX"
+#define LIBRARY_VERSION 1
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t dir_count;
+    uint32_t file_count;
+    uint32_t subdir_count;
+    uint32_t string_size;
+} LibraryHeader;
+
+typedef struct
+{
+    int64_t mtime;         // Directory mtime in nanoseconds
+    uint32_t path;         // String offset of the absolute path
+    uint32_t first_file;   // Index of the first file record
+    uint32_t file_count;   // Number of file records
+    uint32_t first_subdir; // Index of the first subdirectory name
+    uint32_t subdir_count; // Number of subdirectory names
+    uint32_t reserved;
+} LibraryDirRecord;
+
+typedef struct
+{
+    int64_t size;         // Size in bytes
+    int64_t mtime;        // File mtime in nanoseconds
+    uint32_t name;        // String offset of the file name
+    uint32_t duration_ms; // Duration in milliseconds, 0 if unknown
+    uint32_t format;      // LibraryFormat
+    uint32_t reserved;
+} LibraryFileRecord;
+
+// A file of a directory listed during the current scan
+typedef struct
+{
+    char *name;
+    long long size;
+    long long mtime;
+    uint32_t duration_ms;
+} LibraryBuiltFile;
+
+// A directory listed during the current scan
+typedef struct
+{
+    char *path;
+    long long mtime;
+    LibraryBuiltFile *files;
+    size_t file_count;
+    char **subdirs;
+    size_t subdir_count;
+} LibraryBuiltDir;
+
+// One directory of the index being written: freshly listed or kept
+typedef struct
+{
+    const LibraryBuiltDir *built;
+    const LibraryDirRecord *old;
+} LibraryOutDir;
+
+struct Library
+{
+    char path[512];                 // Index file path
+    unsigned char *map;             // Mapped index, NULL if none
+    size_t map_size;
+    const LibraryHeader *header;
+    const LibraryDirRecord *dirs;
+    LibraryFileRecord *files;       // Writable: durations are filled in place
+    const uint32_t *subdirs;
+    const char *strings;
+    pthread_mutex_t lock;           // Guards built and stats (scanner threads)
+    LibraryBuiltDir *built;         // Directories listed since the last commit
+    size_t built_count;
+    size_t built_capacity;
+    ScannerCache cache;
+    LibraryStats stats;
+};
+
+static const char *library_string(const Library *library, uint32_t offset)
+{
+    if (offset >= library->header->string_size)
+        return "";
+    return library->strings + offset;
+}
+
+static char *library_strdup(const char *src)
+{
+    size_t len = strlen(src);
+    char *copy = (char *)malloc(len + 1);
+    if (!copy)
+        return NULL;
+
+    memcpy(copy, src, len + 1);
+    return copy;
+}
+
+static LibraryFormat library_format_for(const char *name)
+{
+    static const char *const extensions[] = {"mp3", "wav", "flac", "m4a", "ogg", "aac", "wma"};
+
+    const char *ext = strrchr(name, '.');
+    if (!ext)
+        return LIBRARY_FORMAT_UNKNOWN;
+
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++)
+    {
+        if (strcasecmp(ext + 1, extensions[i]) == 0)
+            return (LibraryFormat)(LIBRARY_FORMAT_MP3 + i);
+    }
+
+    return LIBRARY_FORMAT_UNKNOWN;
+}
+
+static void library_unmap(Library *library)
+{
+    if (library->map)
+        munmap(library->map, library->map_size);
+
+    library->map = NULL;
+    library->map_size = 0;
+    library->header = NULL;
+    library->dirs = NULL;
+    library->files = NULL;
+    library->subdirs = NULL;
+    library->strings = NULL;
+}
+
+/**
+ * Check that every record of a freshly mapped index stays inside the file
+ */
+static int library_validate(const Library *library)
+{
+    const LibraryHeader *header = library->header;
+
+    if (header->string_size == 0 || library->strings[header->string_size - 1] != '\0')
+        return -1;
+
+    for (uint32_t i = 0; i < header->dir_count; i++)
+    {
+        const LibraryDirRecord *dir = &library->dirs[i];
+        if (dir->path >= header->string_size ||
+            dir->first_file > header->file_count || dir->file_count > header->file_count - dir->first_file ||
+            dir->first_subdir > header->subdir_count || dir->subdir_count > header->subdir_count - dir->first_subdir)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Map the index file, leaving the library empty if it is missing or invalid
+ */
+static void library_map(Library *library)
+{
+    library_unmap(library);
+
+    int fd = open(library->path, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(LibraryHeader))
+    {
+        close(fd);
+        return;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return;
+
+    const LibraryHeader *header = (const LibraryHeader *)map;
+    uint64_t expected = sizeof(LibraryHeader) +
+                        (uint64_t)header->dir_count * sizeof(LibraryDirRecord) +
+                        (uint64_t)header->file_count * sizeof(LibraryFileRecord) +
+                        (uint64_t)header->subdir_count * sizeof(uint32_t) +
+                        header->string_size;
+
+    if (memcmp(header->magic, LIBRARY_MAGIC, 4) != 0 || header->version != LIBRARY_VERSION ||
+        expected != (uint64_t)st.st_size)
+    {
+        munmap(map, (size_t)st.st_size);
+        return;
+    }
+
+    unsigned char *base = (unsigned char *)map;
+    library->map = base;
+    library->map_size = (size_t)st.st_size;
+    library->header = header;
+    base += sizeof(LibraryHeader);
+    library->dirs = (const LibraryDirRecord *)base;
+    base += header->dir_count * sizeof(LibraryDirRecord);
+    library->files = (LibraryFileRecord *)base;
+    base += header->file_count * sizeof(LibraryFileRecord);
+    library->subdirs = (const uint32_t *)base;
+    base += header->subdir_count * sizeof(uint32_t);
+    library->strings = (const char *)base;
+
+    if (library_validate(library) != 0)
+        library_unmap(library);
+}
+
+static const LibraryDirRecord *library_find_dir(const Library *library, const char *path)
+{
+    if (!library->map)
+        return NULL;
+
+    size_t low = 0;
+    size_t high = library->header->dir_count;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        int order = strcmp(path, library_string(library, library->dirs[mid].path));
+        if (order == 0)
+            return &library->dirs[mid];
+        if (order < 0)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+
+    return NULL;
+}
+
+static LibraryFileRecord *library_find_file(const Library *library, const LibraryDirRecord *dir, const char *name)
+{
+    size_t low = dir->first_file;
+    size_t high = (size_t)dir->first_file + dir->file_count;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        int order = strcmp(name, library_string(library, library->files[mid].name));
+        if (order == 0)
+            return &library->files[mid];
+        if (order < 0)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+
+    return NULL;
+}
+
+/**
+ * Find the record of an absolute file path
+ */
+static LibraryFileRecord *library_find_track(const Library *library, const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    if (!library->map || !slash || path[0] != '/')
+        return NULL;
+
+    char dir_path[4096];
+    size_t dir_len = slash > path ? (size_t)(slash - path) : 1;
+    if (dir_len >= sizeof(dir_path))
+        return NULL;
+
+    memcpy(dir_path, path, dir_len);
+    dir_path[dir_len] = '\0';
+
+    const LibraryDirRecord *dir = library_find_dir(library, dir_path);
+    return dir ? library_find_file(library, dir, slash + 1) : NULL;
+}
+
+static void library_free_built(LibraryBuiltDir *dir)
+{
+    free(dir->path);
+    for (size_t i = 0; i < dir->file_count; i++)
+        free(dir->files[i].name);
+    free(dir->files);
+    for (size_t i = 0; i < dir->subdir_count; i++)
+        free(dir->subdirs[i]);
+    free(dir->subdirs);
+}
+
+static int library_compare_built_files(const void *a, const void *b)
+{
+    return strcmp(((const LibraryBuiltFile *)a)->name, ((const LibraryBuiltFile *)b)->name);
+}
+
+static int library_compare_built_dirs(const void *a, const void *b)
+{
+    return strcmp(((const LibraryBuiltDir *)a)->path, ((const LibraryBuiltDir *)b)->path);
+}
+
+/**
+ * ScannerCache.lookup: replay an unchanged directory from the mapping
+ */
+static int library_cache_lookup(void *user_data, const char *path, long long mtime, ScannerSink *sink)
+{
+    Library *library = (Library *)user_data;
+
+    const LibraryDirRecord *dir = library_find_dir(library, path);
+    if (!dir || dir->mtime != mtime)
+        return 0;
+
+    for (uint32_t i = 0; i < dir->file_count; i++)
+    {
+        if (scanner_sink_add_file(sink, library_string(library, library->files[dir->first_file + i].name)) != 0)
+            return 1;
+    }
+
+    for (uint32_t i = 0; i < dir->subdir_count; i++)
+    {
+        if (scanner_sink_add_subdir(sink, library_string(library, library->subdirs[dir->first_subdir + i])) != 0)
+            return 1;
+    }
+
+    pthread_mutex_lock(&library->lock);
+    library->stats.dirs_reused++;
+    pthread_mutex_unlock(&library->lock);
+
+    return 1;
+}
+
+/**
+ * ScannerCache.store: remember a freshly listed directory until commit
+ */
+static void library_cache_store(void *user_data, const char *path, long long mtime,
+                                const ScannerFileInfo *files, size_t file_count,
+                                const char *const *subdirs, size_t subdir_count)
+{
+    Library *library = (Library *)user_data;
+
+    // Relative paths would mean something else from another directory
+    if (path[0] != '/')
+        return;
+
+    LibraryBuiltDir dir;
+    memset(&dir, 0, sizeof(dir));
+    dir.mtime = mtime;
+    dir.path = library_strdup(path);
+    dir.files = (LibraryBuiltFile *)calloc(file_count > 0 ? file_count : 1, sizeof(LibraryBuiltFile));
+    dir.subdirs = (char **)calloc(subdir_count > 0 ? subdir_count : 1, sizeof(char *));
+    if (!dir.path || !dir.files || !dir.subdirs)
+    {
+        library_free_built(&dir);
+        return;
+    }
+
+    const LibraryDirRecord *old = library_find_dir(library, path);
+
+    for (size_t i = 0; i < file_count; i++)
+    {
+        LibraryBuiltFile *file = &dir.files[dir.file_count];
+        file->name = library_strdup(files[i].name);
+        if (!file->name)
+        {
+            library_free_built(&dir);
+            return;
+        }
+        file->size = files[i].size;
+        file->mtime = files[i].mtime;
+
+        // An unchanged file keeps the duration learned earlier
+        const LibraryFileRecord *previous = old ? library_find_file(library, old, file->name) : NULL;
+        if (previous && previous->size == file->size && previous->mtime == file->mtime)
+            file->duration_ms = previous->duration_ms;
+
+        dir.file_count++;
+    }
+
+    for (size_t i = 0; i < subdir_count; i++)
+    {
+        dir.subdirs[dir.subdir_count] = library_strdup(subdirs[i]);
+        if (!dir.subdirs[dir.subdir_count])
+        {
+            library_free_built(&dir);
+            return;
+        }
+        dir.subdir_count++;
+    }
+
+    qsort(dir.files, dir.file_count, sizeof(LibraryBuiltFile), library_compare_built_files);
+
+    pthread_mutex_lock(&library->lock);
+    library->stats.dirs_scanned++;
+    if (library->built_count >= library->built_capacity)
+    {
+        size_t new_capacity = library->built_capacity > 0 ? library->built_capacity * 2 : 16;
+        LibraryBuiltDir *new_built = (LibraryBuiltDir *)realloc(library->built, new_capacity * sizeof(LibraryBuiltDir));
+        if (!new_built)
+        {
+            pthread_mutex_unlock(&library->lock);
+            library_free_built(&dir);
+            return;
+        }
+        library->built = new_built;
+        library->built_capacity = new_capacity;
+    }
+    library->built[library->built_count++] = dir;
+    pthread_mutex_unlock(&library->lock);
+}
+
+static const LibraryBuiltDir *library_find_built(const Library *library, const char *path)
+{
+    LibraryBuiltDir key;
+    key.path = (char *)path;
+    return (const LibraryBuiltDir *)bsearch(&key, library->built, library->built_count,
+                                            sizeof(LibraryBuiltDir), library_compare_built_dirs);
+}
+
+/**
+ * Check if a kept directory disappeared: its nearest relisted ancestor no
+ * longer has the subdirectory that leads to it.
+ */
+static int library_is_orphan(const Library *library, const char *path)
+{
+    char ancestor[4096];
+    size_t len = strlen(path);
+    if (len >= sizeof(ancestor))
+        return 0;
+
+    memcpy(ancestor, path, len + 1);
+
+    char *slash;
+    while ((slash = strrchr(ancestor, '/')) != NULL && slash > ancestor)
+    {
+        *slash = '\0';
+        const LibraryBuiltDir *parent = library_find_built(library, ancestor);
+        if (!parent)
+            continue;
+
+        // The path component right below the ancestor
+        const char *child = path + (slash - ancestor) + 1;
+        const char *child_end = strchr(child, '/');
+        size_t child_len = child_end ? (size_t)(child_end - child) : strlen(child);
+
+        for (size_t i = 0; i < parent->subdir_count; i++)
+        {
+            if (strlen(parent->subdirs[i]) == child_len && strncmp(parent->subdirs[i], child, child_len) == 0)
+                return 0;
+        }
+        return 1;
+    }
+
+    return 0;
+}
+
+static size_t library_append_string(char *strings, size_t *used, const char *text)
+{
+    size_t offset = *used;
+    size_t len = strlen(text) + 1;
+    memcpy(strings + offset, text, len);
+    *used += len;
+    return offset;
+}
+
+/**
+ * Serialize the merged directory list into one buffer
+ */
+static unsigned char *library_serialize(const Library *library, const LibraryOutDir *out, size_t out_count, size_t *out_size)
+{
+    uint64_t file_count = 0;
+    uint64_t subdir_count = 0;
+    uint64_t string_size = 0;
+
+    for (size_t i = 0; i < out_count; i++)
+    {
+        if (out[i].built)
+        {
+            const LibraryBuiltDir *dir = out[i].built;
+            string_size += strlen(dir->path) + 1;
+            file_count += dir->file_count;
+            subdir_count += dir->subdir_count;
+            for (size_t j = 0; j < dir->file_count; j++)
+                string_size += strlen(dir->files[j].name) + 1;
+            for (size_t j = 0; j < dir->subdir_count; j++)
+                string_size += strlen(dir->subdirs[j]) + 1;
+        }
+        else
+        {
+            const LibraryDirRecord *dir = out[i].old;
+            string_size += strlen(library_string(library, dir->path)) + 1;
+            file_count += dir->file_count;
+            subdir_count += dir->subdir_count;
+            for (uint32_t j = 0; j < dir->file_count; j++)
+                string_size += strlen(library_string(library, library->files[dir->first_file + j].name)) + 1;
+            for (uint32_t j = 0; j < dir->subdir_count; j++)
+                string_size += strlen(library_string(library, library->subdirs[dir->first_subdir + j])) + 1;
+        }
+    }
+
+    if (string_size == 0)
+        string_size = 1;
+
+    uint64_t total = sizeof(LibraryHeader) + out_count * sizeof(LibraryDirRecord) +
+                     file_count * sizeof(LibraryFileRecord) + subdir_count * sizeof(uint32_t) + string_size;
+    if (string_size > UINT32_MAX || file_count > UINT32_MAX || total > SIZE_MAX)
+        return NULL;
+
+    unsigned char *buffer = (unsigned char *)calloc(1, (size_t)total);
+    if (!buffer)
+        return NULL;
+
+    LibraryHeader *header = (LibraryHeader *)buffer;
+    LibraryDirRecord *dirs = (LibraryDirRecord *)(header + 1);
+    LibraryFileRecord *files = (LibraryFileRecord *)(dirs + out_count);
+    uint32_t *subdirs = (uint32_t *)(files + file_count);
+    char *strings = (char *)(subdirs + subdir_count);
+
+    memcpy(header->magic, LIBRARY_MAGIC, 4);
+    header->version = LIBRARY_VERSION;
+    header->dir_count = (uint32_t)out_count;
+    header->file_count = (uint32_t)file_count;
+    header->subdir_count = (uint32_t)subdir_count;
+    header->string_size = (uint32_t)string_size;
+
+    size_t used = 0;
+    uint32_t next_file = 0;
+    uint32_t next_subdir = 0;
+
+    for (size_t i = 0; i < out_count; i++)
+    {
+        LibraryDirRecord *dir = &dirs[i];
+        dir->first_file = next_file;
+        dir->first_subdir = next_subdir;
+
+        if (out[i].built)
+        {
+            const LibraryBuiltDir *src = out[i].built;
+            dir->mtime = src->mtime;
+            dir->path = (uint32_t)library_append_string(strings, &used, src->path);
+            for (size_t j = 0; j < src->file_count; j++)
+            {
+                LibraryFileRecord *file = &files[next_file++];
+                file->size = src->files[j].size;
+                file->mtime = src->files[j].mtime;
+                file->duration_ms = src->files[j].duration_ms;
+                file->format = library_format_for(src->files[j].name);
+                file->name = (uint32_t)library_append_string(strings, &used, src->files[j].name);
+            }
+            for (size_t j = 0; j < src->subdir_count; j++)
+                subdirs[next_subdir++] = (uint32_t)library_append_string(strings, &used, src->subdirs[j]);
+        }
+        else
+        {
+            const LibraryDirRecord *src = out[i].old;
+            dir->mtime = src->mtime;
+            dir->path = (uint32_t)library_append_string(strings, &used, library_string(library, src->path));
+            for (uint32_t j = 0; j < src->file_count; j++)
+            {
+                LibraryFileRecord *file = &files[next_file++];
+                *file = library->files[src->first_file + j];
+                file->name = (uint32_t)library_append_string(strings, &used, library_string(library, file->name));
+            }
+            for (uint32_t j = 0; j < src->subdir_count; j++)
+            {
+                const char *name = library_string(library, library->subdirs[src->first_subdir + j]);
+                subdirs[next_subdir++] = (uint32_t)library_append_string(strings, &used, name);
+            }
+        }
+
+        dir->file_count = next_file - dir->first_file;
+        dir->subdir_count = next_subdir - dir->first_subdir;
+    }
+
+    *out_size = (size_t)total;
+    return buffer;
+}
+
+static int library_write_file(const char *path, const unsigned char *data, size_t size)
+{
+    char tmp_path[600];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    config_ensure_dir();
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -1;
+
+    size_t written = 0;
+    while (written < size)
+    {
+        ssize_t result = write(fd, data + written, size - written);
+        if (result <= 0)
+        {
+            close(fd);
+            unlink(tmp_path);
+            return -1;
+        }
+        written += (size_t)result;
+    }
+
+    if (close(fd) != 0 || rename(tmp_path, path) != 0)
+    {
+        unlink(tmp_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+Library *library_open(void)
+{
+    Library *library = (Library *)calloc(1, sizeof(Library));
+    if (!library)
+        return NULL;
+
+    if (config_path(library->path, sizeof(library->path), LIBRARY_FILE) != 0)
+        library->path[0] = '\0';
+
+    pthread_mutex_init(&library->lock, NULL);
+
+    library->cache.user_data = library;
+    library->cache.lookup = library_cache_lookup;
+    library->cache.store = library_cache_store;
+
+    if (library->path[0])
+        library_map(library);
+
+    return library;
+}
+
+void library_close(Library *library)
+{
+    if (!library)
+        return;
+
+    for (size_t i = 0; i < library->built_count; i++)
+        library_free_built(&library->built[i]);
+    free(library->built);
+
+    library_unmap(library);
+    pthread_mutex_destroy(&library->lock);
+    free(library);
+}
+
+const ScannerCache *library_scan_cache(Library *library)
+{
+    return library ? &library->cache : NULL;
+}
+
+int library_commit(Library *library)
+{
+    if (!library || library->built_count == 0)
+        return 0;
+
+    int result = -1;
+    size_t old_count = library->map ? library->header->dir_count : 0;
+
+    qsort(library->built, library->built_count, sizeof(LibraryBuiltDir), library_compare_built_dirs);
+
+    LibraryOutDir *out = (LibraryOutDir *)malloc((old_count + library->built_count) * sizeof(LibraryOutDir));
+    if (out && library->path[0])
+    {
+        // Merge both sorted lists; a relisted directory replaces its old record
+        size_t out_count = 0;
+        size_t i = 0;
+        size_t j = 0;
+        while (i < old_count || j < library->built_count)
+        {
+            const LibraryDirRecord *old = i < old_count ? &library->dirs[i] : NULL;
+            const LibraryBuiltDir *built = j < library->built_count ? &library->built[j] : NULL;
+            int order = !old ? 1 : !built ? -1 : strcmp(library_string(library, old->path), built->path);
+
+            if (order < 0)
+            {
+                if (!library_is_orphan(library, library_string(library, old->path)))
+                    out[out_count++] = (LibraryOutDir){NULL, old};
+                i++;
+            }
+            else
+            {
+                // Same directory listed twice since the last commit: keep one
+                if (out_count == 0 || !out[out_count - 1].built || strcmp(out[out_count - 1].built->path, built->path) != 0)
+                    out[out_count++] = (LibraryOutDir){built, NULL};
+                if (order == 0)
+                    i++;
+                j++;
+            }
+        }
+
+        size_t size = 0;
+        unsigned char *data = library_serialize(library, out, out_count, &size);
+        if (data)
+        {
+            result = library_write_file(library->path, data, size);
+            free(data);
+        }
+    }
+    free(out);
+
+    for (size_t k = 0; k < library->built_count; k++)
+        library_free_built(&library->built[k]);
+    library->built_count = 0;
+
+    if (result == 0)
+        library_map(library);
+
+    return result;
+}
+
+int library_get_track(Library *library, const char *path, LibraryTrack *out)
+{
+    if (!library || !path || !out)
+        return -1;
+
+    const LibraryFileRecord *file = library_find_track(library, path);
+    if (!file)
+        return -1;
+
+    out->size = file->size;
+    out->mtime = file->mtime;
+    out->duration = file->duration_ms / 1000.0f;
+    out->format = (LibraryFormat)file->format;
+    return 0;
+}
+
+void library_set_duration(Library *library, const char *path, float seconds)
+{
+    if (!library || !path || seconds <= 0.0f)
+        return;
+
+    LibraryFileRecord *file = library_find_track(library, path);
+    if (file)
+        file->duration_ms = (uint32_t)(seconds * 1000.0f + 0.5f);
+}
+
+void library_get_stats(Library *library, LibraryStats *out)
+{
+    if (!out)
+        return;
+
+    memset(out, 0, sizeof(*out));
+
+    if (!library)
+        return;
+
+    pthread_mutex_lock(&library->lock);
+    *out = library->stats;
+    pthread_mutex_unlock(&library->lock);
+}
@@ -0,0 +1,100 @@
+/**
+ * library.h - Persistent library index
+ *
+ * Remembers the audio files of every scanned directory in
+ * ~/.config/walcman/library.idx, keyed by the directory's modification time.
+ * Folder loads replay unchanged directories from the memory-mapped index
+ * instead of listing and stat()ing their files again.
+ *
+ * A directory's mtime changes when entries are added, removed or renamed,
+ * not when a file is rewritten in place; such files keep their old record.
+ */
+
+#ifndef WALCMAN_LIBRARY_H
+#define WALCMAN_LIBRARY_H
+
+#include "scanner.h"
+
+// Audio formats recorded in the index
+typedef enum
+{
+    LIBRARY_FORMAT_UNKNOWN = 0,
+    LIBRARY_FORMAT_MP3,
+    LIBRARY_FORMAT_WAV,
+    LIBRARY_FORMAT_FLAC,
+    LIBRARY_FORMAT_M4A,
+    LIBRARY_FORMAT_OGG,
+    LIBRARY_FORMAT_AAC,
+    LIBRARY_FORMAT_WMA
+} LibraryFormat;
+
+// What the index knows about one file
+typedef struct LibraryTrack
+{
+    long long size;         // Size in bytes
+    long long mtime;        // Modification time in nanoseconds
+    float duration;         // Length in seconds, 0 if not known yet
+    LibraryFormat format;   // Format from the file extension
+} LibraryTrack;
+
+// Index counters for the current session
+typedef struct LibraryStats
+{
+    unsigned long dirs_reused;  // Directories replayed from the index
+    unsigned long dirs_scanned; // Directories listed from disk
+} LibraryStats;
+
+typedef struct Library Library;
+
+/**
+ * Open the library index, mapping the existing file if there is one
+ * Returns: Library instance (empty if no index exists yet), or NULL on failure
+ */
+Library *library_open(void);
+
+/**
+ * Close the index and release the mapping
+ * library: Library instance (may be NULL)
+ */
+void library_close(Library *library);
+
+/**
+ * Get the scanner cache backed by this index
+ * library: Library instance
+ * Returns: Cache to pass to scanner_scan(), or NULL if library is NULL
+ */
+const ScannerCache *library_scan_cache(Library *library);
+
+/**
+ * Write directories listed since the last commit back to the index.
+ * The file is replaced atomically (temporary file + rename) and remapped.
+ * library: Library instance
+ * Returns: 0 on success or when nothing changed, -1 on failure
+ */
+int library_commit(Library *library);
+
+/**
+ * Look up a file in the index
+ * library: Library instance
+ * path: Absolute file path
+ * out: Receives the record
+ * Returns: 0 if found, -1 otherwise
+ */
+int library_get_track(Library *library, const char *path, LibraryTrack *out);
+
+/**
+ * Remember the duration of an indexed file (written straight to the mapping)
+ * library: Library instance
+ * path: Absolute file path
+ * seconds: Duration in seconds
+ */
+void library_set_duration(Library *library, const char *path, float seconds);
+
+/**
+ * Get index counters
+ * library: Library instance
+ * out: Receives the counters (zeroed if library is NULL)
+ */
+void library_get_stats(Library *library, LibraryStats *out);
+
+#endif // WALCMAN_LIBRARY_H
@@ -0,0 +1,116 @@
+/**
+ * loudness.h - Loudness scanner and per-track gain
+ *
+ * Measures integrated loudness (ITU-R BS.1770 / EBU R128: K-weighting,
+ * 400 ms blocks, absolute and relative gating) and true peak of audio
+ * files on background threads. The files are decoded without any output
+ * device, at low priority, so scans never compete with playback.
+ *
+ * Results are kept in ~/.config/walcman/loudness.cache, keyed by path,
+ * size and mtime, and turned into a gain that brings every track to the
+ * same target loudness.
+ */
+
+#ifndef WALCMAN_LOUDNESS_H
+#define WALCMAN_LOUDNESS_H
+
+#include <stddef.h>
+
+#define LOUDNESS_TARGET_LUFS -18.0 // Default target (ReplayGain 2.0 reference level)
+#define LOUDNESS_MAX_THREADS 4      // Upper limit for loudness_threads
+
+// Measurement of one file
+typedef struct LoudnessResult
+{
+    double loudness; // Integrated loudness in LUFS
+    double peak;     // True peak in dBTP
+    double seconds;  // Audio length analyzed
+} LoudnessResult;
+
+// Scanner counters for the current session
+typedef struct LoudnessStats
+{
+    unsigned long scanned;  // Files analyzed this session
+    unsigned long failed;   // Files that could not be decoded
+    unsigned long known;    // Files with a result (cached or scanned)
+    size_t pending;         // Files waiting for a worker
+    double audio_seconds;   // Audio analyzed this session
+    double scan_seconds;    // Worker time spent on it
+} LoudnessStats;
+
+typedef struct Loudness Loudness;
+
+/**
+ * Analyze a file on the calling thread
+ * filepath: Audio file
+ * out: Receives the measurement
+ * Returns: 0 on success, -1 if the file cannot be decoded
+ */
+int loudness_analyze_file(const char *filepath, LoudnessResult *out);
+
+/**
+ * Load the result cache and start the scanner threads
+ * threads: Worker threads (at least 1)
+ * target: Loudness every track is brought to, in LUFS
+ * limit: 1 to lower the gain of tracks whose true peak would clip
+ * on_result: Called from a worker thread after each new result (may be NULL)
+ * user_data: Passed to on_result
+ * Returns: Scanner instance, or NULL on failure
+ */
+Loudness *loudness_create(int threads, double target, int limit,
+                          void (*on_result)(void *user_data), void *user_data);
+
+/**
+ * Stop the scanner threads and save new results
+ * loudness: Scanner instance (may be NULL)
+ */
+void loudness_destroy(Loudness *loudness);
+
+/**
+ * Queue a file for scanning unless its result is already known
+ * loudness: Scanner instance
+ * filepath: Audio file
+ * first: 1 to scan it before everything already waiting
+ */
+void loudness_scan(Loudness *loudness, const char *filepath, int first);
+
+/**
+ * Measure a file on the calling thread unless its result is already known
+ * loudness: Scanner instance
+ * filepath: Audio file
+ * Returns: 0 if the file has a result afterwards, -1 if it cannot be decoded
+ */
+int loudness_measure(Loudness *loudness, const char *filepath);
+
+/**
+ * Drop every file still waiting for a worker
+ * loudness: Scanner instance
+ */
+void loudness_cancel(Loudness *loudness);
+
+/**
+ * Look up a file's result (any thread)
+ * loudness: Scanner instance
+ * filepath: Audio file
+ * out: Receives the result
+ * Returns: 0 if the current version of the file was measured, -1 otherwise
+ */
+int loudness_lookup(Loudness *loudness, const char *filepath, LoudnessResult *out);
+
+/**
+ * Get the linear gain for a file (any thread)
+ * loudness: Scanner instance
+ * filepath: Audio file
+ * gain: Receives the gain; 1.0 if the file was not measured
+ * Returns: 1 if the gain comes from a measurement, 0 otherwise
+ */
+int loudness_get_gain(Loudness *loudness, const char *filepath, float *gain);
+
+/**
+ * Get scanner counters
+ * loudness: Scanner instance (may be NULL)
+ * out: Receives the counters
+ */
+void loudness_get_stats(Loudness *loudness, LoudnessStats *out);
+
+#endif // WALCMAN_LOUDNESS_H
@@ -5,7 +5,11 @@
  * - Initialization of player and UI systems
  * - Command-line argument processing (direct file playback)
  * - Interactive mode with welcome screen
- * - Main event loop with input polling and song end detection
+ * - Main event loop: sleeps in poll() on stdin and the player's event pipe,
+ *   so keystrokes and track ends are handled as soon as they happen; while a
+ *   track plays, the frame scheduler sets the timeout for progress redraws
+ * - Daemon mode: no terminal UI, controlled through the control socket
+ * - Render mode: the queue mixed into a WAV file, without an audio device
  * - Clean shutdown and resource cleanup
  */
 
@@ -13,6 +17,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include "player.h"
 #include "app_controller.h"
@@ -24,8 +33,12 @@
 #include "terminal.h"
 #include "update.h"
 #include "screen_state.h"
-
-#define INPUT_POLL_INTERVAL_US 50000 // Poll for input every 50ms
+#include "ui_scheduler.h"
+#include "visualizer.h"
+#include "bench.h"
+#include "config.h"
+#include "control.h"
+#include "render.h"
 
 static int path_is_directory(const char *path)
 {
@@ -40,18 +53,567 @@ static int path_is_directory(const char *path)
     return S_ISDIR(st.st_mode) ? 1 : 0;
 }
 
+// Player events handled since the main loop last looked
+typedef struct PlayerEvents
+{
+    Player *player;
+    AppController *controller;
+    int load_result; // Last non-zero app_controller_poll_load() result
+    int track_ended;
+} PlayerEvents;
+
+/**
+ * Handle a wakeup from the player's event pipe: finish background loads
+ * and move on when the current track ended
+ */
+static void player_events_handle(PlayerEvents *events)
+{
+    player_drain_events(events->player);
+
+    // The loudness scanner may have measured the preloaded track
+    player_refresh_gain(events->player);
+
+    // A background load may have finished
+    int load_result = app_controller_poll_load(events->controller);
+    if (load_result != 0)
+        events->load_result = load_result;
+
+    // Taken even when not playing, so an end seen during a load is dropped
+    int ended = player_take_track_end(events->player);
+    if (ended && player_get_state(events->player) == STATE_PLAYING)
+    {
+        app_controller_handle_track_end(events->controller);
+        events->track_ended = 1;
+    }
+}
+
+// Terminal read hook: keeps playback going while a prompt is open
+static void player_events_on_ready(void *user_data)
+{
+    player_events_handle((PlayerEvents *)user_data);
+}
+
+/**
+ * Print resource usage collected during the session (--stats)
+ * scheduler, visualizer: UI counters to include, or NULL in daemon mode
+ */
+static void print_stats(Player *player, AppController *controller, const UIScheduler *scheduler,
+                        const Visualizer *visualizer)
+{
+    PlayerStats stats;
+    player_get_stats(player, &stats);
+
+    LibraryStats library_stats;
+    library_get_stats(app_controller_get_library(controller), &library_stats);
+
+    UIRenderStats render_stats;
+    ui_get_render_stats(&render_stats);
+
+    UISchedulerStats frame_stats;
+    ui_scheduler_get_stats(scheduler, &frame_stats);
+
+    VisualizerStats vis_stats;
+    visualizer_get_stats(visualizer, &vis_stats);
+
+    PlayerTelemetry telemetry;
+    player_get_telemetry(player, &telemetry);
+
+    LoudnessStats loudness_stats;
+    loudness_get_stats(controller->loudness, &loudness_stats);
+
+    printf("Tracks loaded: %lu (%lu streamed, %lu gapless)\n",
+           stats.tracks_loaded, stats.tracks_streamed, stats.tracks_gapless);
+    printf("Track cache: %lu hits, %lu misses, %zu tracks in %.1f MB\n",
+           stats.cache_hits, stats.cache_misses, stats.cache_tracks, stats.cache_bytes / (1024.0 * 1024.0));
+    printf("Loudness: %lu scanned (%.0fx real time), %lu failed, %lu known, %zu pending\n",
+           loudness_stats.scanned,
+           loudness_stats.scan_seconds > 0.0 ? loudness_stats.audio_seconds / loudness_stats.scan_seconds : 0.0,
+           loudness_stats.failed, loudness_stats.known, loudness_stats.pending);
+    printf("Seek indexes: %lu built, %lu from disk\n", stats.seek_indexes_built, stats.seek_indexes_loaded);
+    printf("Audio callbacks: %llu, %.0f us max for %.0f us periods, %llu underruns\n",
+           telemetry.callbacks, telemetry.callback_max_us, telemetry.period_us, telemetry.underruns);
+    printf("Library folders: %lu from index, %lu scanned\n", library_stats.dirs_reused, library_stats.dirs_scanned);
+    if (scheduler)
+    {
+        printf("UI frames: %lu (%lu full), %.1f KB written (%.1f KB with full redraws)\n",
+               render_stats.frames, render_stats.full_frames,
+               render_stats.bytes_written / 1024.0, render_stats.bytes_full_redraw / 1024.0);
+        printf("Progress frames: %lu drawn, %lu skipped, %.2f ms avg, %.2f ms max\n",
+               frame_stats.frames, frame_stats.skipped,
+               frame_stats.frames > 0 ? frame_stats.frame_ms_total / frame_stats.frames : 0.0,
+               frame_stats.frame_ms_max);
+    }
+    if (visualizer)
+    {
+        printf("Visualizer: %lu updates, %.3f ms avg, %.3f ms max (%zu-point FFT)\n",
+               vis_stats.frames, vis_stats.frames > 0 ? vis_stats.ms_total / vis_stats.frames : 0.0,
+               vis_stats.ms_max, visualizer->fft_size);
+    }
+    printf("Peak memory: %.1f MB\n", util_peak_memory_kb() / 1024.0);
+}
+
+/**
+ * Queue the paths given after the first one on the command line
+ * paths: File paths (folders are skipped with an error)
+ * count: Number of paths
+ */
+static void enqueue_paths(AppController *controller, char *const *paths, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (path_is_directory(paths[i]) || app_controller_enqueue_file(controller, paths[i]) != 0)
+            error_print(ERR_FILE_LOAD, paths[i]);
+    }
+}
+
+/**
+ * Clean up a path from the command line the way a typed path is cleaned
+ * up: surrounding quotes and backslash escapes are removed
+ */
+static void normalize_path_arg(const char *arg, char *out, size_t out_size)
+{
+    strncpy(out, arg, out_size - 1);
+    out[out_size - 1] = '\0';
+    strip_quotes(out);
+    unescape_path(out);
+}
+
+/**
+ * Send one play or enqueue request to a running instance
+ * label: Path as given on the command line, for error messages
+ * Returns: 0 on success, -1 if the instance refused or did not answer
+ */
+static int forward_request(int fd, const char *verb, const char *path, const char *label)
+{
+    char command[PATH_MAX + 16];
+    snprintf(command, sizeof(command), path[0] ? "%s %s" : "%s", verb, path);
+
+    char reason[256];
+    if (control_request(fd, command, reason, sizeof(reason)) == 0)
+        return 0;
+
+    fprintf(stderr, "walcman: %s: %s\n", label, reason[0] ? reason : "no reply from running instance");
+    return -1;
+}
+
+/**
+ * Forward a folder: its playable files replace the queue of the running
+ * instance, which starts them the way it starts a folder it loads itself.
+ * The folder is listed here (through the shared library index), since a
+ * scan in the running instance would hold up its event loop.
+ * Returns: 0 on success, -1 if nothing could be forwarded
+ */
+static int forward_folder(int fd, const char *folder, const char *label)
+{
+    Queue *listing = queue_create();
+    if (!listing)
+        return -1;
+
+    Library *library = library_open();
+    queue_set_scan_cache(listing, library_scan_cache(library));
+
+    int loaded = config_get_long("scan_recursive", 0) ? queue_load_folder_recursive(listing, folder)
+                                                      : queue_load_folder(listing, folder);
+    library_commit(library);
+
+    int result = 0;
+    if (loaded <= 0)
+    {
+        fprintf(stderr, "walcman: %s: no playable files in folder\n", label);
+        result = -1;
+    }
+
+    // A file that cannot be staged (e.g. removed meanwhile) is reported and left out
+    for (size_t i = 0; result == 0 && i < queue_count(listing); i++)
+    {
+        const char *path = queue_get_item(listing, i);
+        forward_request(fd, "stage", path, path);
+    }
+
+    if (result == 0 && forward_request(fd, "start", "", label) != 0)
+        result = -1;
+
+    queue_destroy(listing);
+    library_close(library);
+    return result;
+}
+
+/**
+ * Hand command line paths to an instance that is already running, so a
+ * second walcman never opens its own audio device. The first path
+ * replaces what is playing unless enqueue is set; the rest are queued.
+ * Returns: Exit code once forwarded, or -1 if no instance is listening
+ */
+static int forward_paths(char *const *paths, int count, int enqueue)
+{
+    int fd = control_connect(NULL);
+    if (fd < 0)
+        return -1;
+
+    int exit_code = 0;
+    for (int i = 0; i < count; i++)
+    {
+        char path[PATH_MAX];
+        normalize_path_arg(paths[i], path, sizeof(path));
+
+        // The running instance has its own working directory
+        char resolved[PATH_MAX];
+        if (!realpath(path, resolved))
+        {
+            error_print(ERR_FILE_NOT_FOUND, paths[i]);
+            exit_code = 1;
+            continue;
+        }
+
+        int replace = i == 0 && !enqueue;
+        int result = replace && path_is_directory(resolved)
+                         ? forward_folder(fd, resolved, paths[i])
+                         : forward_request(fd, replace ? "play" : "enqueue", resolved, paths[i]);
+        if (result != 0)
+            exit_code = 1;
+    }
+
+    close(fd);
+    return exit_code;
+}
+
+// Set by SIGINT/SIGTERM to end daemon mode
+static volatile sig_atomic_t daemon_stop = 0;
+
+// Self-pipe the signal handler writes to, so a signal always wakes poll()
+static int daemon_signal_pipe[2] = {-1, -1};
+
+static void daemon_on_signal(int sig)
+{
+    (void)sig;
+    int saved_errno = errno;
+    daemon_stop = 1;
+
+    char byte = 1;
+    ssize_t written = write(daemon_signal_pipe[1], &byte, 1);
+    (void)written; // A full pipe already has a wakeup pending
+    errno = saved_errno;
+}
+
+/**
+ * Create the signal self-pipe (non-blocking, not inherited)
+ * Returns: 0 on success, -1 on failure
+ */
+static int daemon_signal_pipe_open(void)
+{
+    if (pipe(daemon_signal_pipe) != 0)
+        return -1;
+
+    for (int i = 0; i < 2; i++)
+    {
+        int flags = fcntl(daemon_signal_pipe[i], F_GETFL, 0);
+        fcntl(daemon_signal_pipe[i], F_SETFL, flags | O_NONBLOCK);
+        fcntl(daemon_signal_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    return 0;
+}
+
+/**
+ * Run without a terminal UI, controlled only through the control socket
+ * (--daemon). Never touches the terminal, so it works detached from one.
+ * paths: Command line paths; the first file or folder starts playing, the
+ *        other files are queued
+ * path_count: Number of paths
+ * show_stats: 1 to print statistics on exit
+ * Returns: Process exit code
+ */
+static int run_daemon(char *const *paths, int path_count, int show_stats)
+{
+    Player *player = player_create();
+    if (!player)
+    {
+        error_print(ERR_PLAYER_INIT, "Could not initialize audio engine");
+        return 1;
+    }
+
+    AppController *controller = app_controller_create(player);
+    if (!controller)
+    {
+        error_print(ERR_PLAYER_INIT, "Could not initialize controller");
+        player_destroy(player);
+        return 1;
+    }
+
+    ControlServer *server = control_server_open(controller, NULL);
+    if (!server)
+    {
+        error_print(ERR_PLAYER_INIT, "Could not open the control socket (is walcman already running?)");
+        app_controller_destroy(controller);
+        player_destroy(player);
+        return 1;
+    }
+
+    if (path_count > 0)
+    {
+        int started = path_is_directory(paths[0])
+                          ? app_controller_load_playlist_folder(controller, paths[0]) > 0
+                          : app_controller_play_file_now(controller, paths[0]) == 0;
+        if (!started)
+            error_print(ERR_FILE_LOAD, paths[0]);
+        enqueue_paths(controller, paths + 1, path_count - 1);
+    }
+
+    // Without the pipe a signal between the loop check and poll() would be missed
+    if (daemon_signal_pipe_open() != 0)
+    {
+        error_print(ERR_PLAYER_INIT, "Failed to create signal pipe");
+        control_server_close(server);
+        app_controller_destroy(controller);
+        player_destroy(player);
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = daemon_on_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    PlayerEvents events = {player, controller, 0, 0};
+    struct pollfd *fds = NULL;
+    size_t fds_capacity = 0;
+
+    while (!daemon_stop)
+    {
+        // Slot 0 is the player's event pipe, slot 1 the signal pipe, the rest
+        // belong to the control server
+        size_t needed = control_server_pollfd_count(server) + 2;
+        if (needed > fds_capacity)
+        {
+            struct pollfd *grown = (struct pollfd *)realloc(fds, needed * sizeof(struct pollfd));
+            if (!grown)
+                break;
+            fds = grown;
+            fds_capacity = needed;
+        }
+
+        fds[0].fd = player_get_event_fd(player);
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = daemon_signal_pipe[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        size_t count = control_server_fill_pollfds(server, fds + 2, fds_capacity - 2);
+
+        if (poll(fds, count + 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        // daemon_stop is already set; the byte only had to wake poll()
+        if (fds[1].revents & POLLIN)
+            break;
+
+        if (fds[0].revents & POLLIN)
+            player_events_handle(&events);
+        events.track_ended = 0;
+        events.load_result = 0;
+
+        if (control_server_dispatch(server, fds + 2, count))
+            break;
+    }
+
+    // Back to the default handlers before the pipe goes away
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    close(daemon_signal_pipe[0]);
+    close(daemon_signal_pipe[1]);
+
+    free(fds);
+    control_server_close(server);
+
+    if (show_stats)
+        print_stats(player, controller, NULL, NULL);
+
+    app_controller_destroy(controller);
+    player_destroy(player);
+    return 0;
+}
+
+/**
+ * Parse the count given to --passes
+ * Returns: Number of passes, or -1 if text is not a whole number in range
+ */
+static int parse_passes(const char *text)
+{
+    char *end = NULL;
+    errno = 0;
+    long passes = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE)
+        return -1;
+    if (passes < 1 || passes > RENDER_PASSES_MAX)
+        return -1;
+    return (int)passes;
+}
+
+/**
+ * Render the queue built from paths into a WAV file (--render)
+ * Returns: Process exit code
+ */
+static int run_render(const char *out_path, char *const *paths, int path_count, int shuffle, int passes,
+                      int show_stats)
+{
+    if (path_count == 0)
+    {
+        fprintf(stderr, "walcman: --render needs a file or folder to play\n");
+        return 1;
+    }
+
+    Player *player = player_create_offline(RENDER_SAMPLE_RATE, RENDER_CHANNELS);
+    if (!player)
+    {
+        error_print(ERR_PLAYER_INIT, "Could not initialize audio engine");
+        return 1;
+    }
+
+    AppController *controller = app_controller_create(player);
+    if (!controller)
+    {
+        error_print(ERR_PLAYER_INIT, "Could not initialize controller");
+        player_destroy(player);
+        return 1;
+    }
+
+    // Gains must not depend on how far the background scan got
+    app_controller_set_measure_first(controller, 1);
+
+    // Set before loading, so a folder starts at the first track of the shuffle order
+    if (shuffle)
+        app_controller_toggle_shuffle(controller);
+
+    int started = path_is_directory(paths[0])
+                      ? app_controller_load_playlist_folder(controller, paths[0]) > 0
+                      : app_controller_play_file_now(controller, paths[0]) == 0;
+    if (!started)
+    {
+        error_print(ERR_FILE_LOAD, paths[0]);
+        app_controller_destroy(controller);
+        player_destroy(player);
+        return 1;
+    }
+    enqueue_paths(controller, paths + 1, path_count - 1);
+
+    RenderStats stats;
+    int result = render_queue(controller, out_path, passes, &stats);
+    if (result == 0 || stats.failed > 0)
+    {
+        printf("Rendered %lu tracks, %.1f s of audio in %.2f s (%.0fx real time): %s\n",
+               stats.tracks, stats.audio_seconds, stats.render_seconds,
+               stats.render_seconds > 0.0 ? stats.audio_seconds / stats.render_seconds : 0.0, out_path);
+    }
+    if (stats.failed > 0)
+        fprintf(stderr, "walcman: %lu tracks could not be loaded and are missing from %s\n", stats.failed, out_path);
+
+    if (show_stats)
+        print_stats(player, controller, NULL, NULL);
+
+    app_controller_destroy(controller);
+    player_destroy(player);
+    return result == 0 ? 0 : 1;
+}
+
 /**
  * Application entry point
  *
- * Supports two modes:
+ * Supports four modes:
  * 1. Direct playback: walcman <filepath> - plays file immediately
  * 2. Interactive: walcman - shows welcome screen, wait for commands
+ * 3. Daemon: walcman --daemon [filepath] - no UI, see control.h
+ * 4. Render: walcman --render out.wav <paths> - write the queue to a file, see render.h
+ *
+ * If another instance is already running, file arguments are forwarded to
+ * it over the control socket and this process exits right away.
+ *
+ * Options:
+ * --stats: print playback and memory statistics on exit
+ * --bench-queue [paths]: time queue load/clear cycles and exit
+ * --bench-startup [file]: time first frame, engine init and first audio, and exit
+ * --bench-loudness <file>: measure a file's loudness and scan speed, and exit
+ * --bench-seek <file>: time seeks within a file, and exit
+ * --daemon: run headless, controlled through the control socket
+ * --enqueue: queue the files in a running instance instead of playing them
+ * --render <out.wav>: mix the queue into a WAV file as fast as possible, and exit
+ * --shuffle, --passes <n>: play order and number of times through the queue for --render
  */
 int main(int argc, char *argv[])
 {
+    const char *path_arg = NULL;
+    int show_stats = 0;
+    int daemon_mode = 0;
+    int enqueue_mode = 0;
+    const char *render_path = NULL;
+    int render_shuffle = 0;
+    int render_passes = 1;
+
+    // Paths in argv order
+    char *paths[argc];
+    int path_count = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--stats") == 0)
+            show_stats = 1;
+        else if (strcmp(argv[i], "--bench-queue") == 0)
+        {
+            long paths = i + 1 < argc ? strtol(argv[i + 1], NULL, 10) : 0;
+            return bench_queue(paths > 0 ? (size_t)paths : 100000) == 0 ? 0 : 1;
+        }
+        else if (strcmp(argv[i], "--bench-startup") == 0)
+            return bench_startup(i + 1 < argc ? argv[i + 1] : NULL) == 0 ? 0 : 1;
+        else if (strcmp(argv[i], "--bench-loudness") == 0)
+            return bench_loudness(i + 1 < argc ? argv[i + 1] : NULL) == 0 ? 0 : 1;
+        else if (strcmp(argv[i], "--bench-seek") == 0)
+            return bench_seek(i + 1 < argc ? argv[i + 1] : NULL) == 0 ? 0 : 1;
+        else if (strcmp(argv[i], "--daemon") == 0)
+            daemon_mode = 1;
+        else if (strcmp(argv[i], "--enqueue") == 0)
+            enqueue_mode = 1;
+        else if (strcmp(argv[i], "--render") == 0 && i + 1 < argc)
+            render_path = argv[++i];
+        else if (strcmp(argv[i], "--shuffle") == 0)
+            render_shuffle = 1;
+        else if (strcmp(argv[i], "--passes") == 0)
+        {
+            render_passes = i + 1 < argc ? parse_passes(argv[++i]) : -1;
+            if (render_passes < 0)
+            {
+                fprintf(stderr, "walcman: --passes needs a whole number from 1 to %d\n", RENDER_PASSES_MAX);
+                return 1;
+            }
+        }
+        else
+            paths[path_count++] = argv[i];
+    }
+    path_arg = path_count > 0 ? paths[0] : NULL;
+
+    // Renders never touch a running instance or the audio device
+    if (render_path)
+        return run_render(render_path, paths, path_count, render_shuffle, render_passes, show_stats);
+
+    // Forwarding first: no update check and no audio engine for a process
+    // that exits again within milliseconds
+    if (path_count > 0 && !daemon_mode)
+    {
+        int forwarded = forward_paths(paths, path_count, enqueue_mode);
+        if (forwarded >= 0)
+            return forwarded;
+    }
+
     // Check for updates in background (silent, non-blocking)
     update_check_background();
 
+    if (daemon_mode)
+        return run_daemon(paths, path_count, show_stats);
+
     Player *player = player_create();
     if (!player)
     {
@@ -77,19 +639,34 @@ int main(int argc, char *argv[])
     }
 
     int running = 1;
+    int exit_code = 0;
     int show_controls = 0; // Controls hidden by default
 
+    // The first track given on the command line loads in the background;
+    // if it cannot be loaded walcman exits with an error as it always did.
+    int exit_on_load_failure = path_arg != NULL;
+
     // Interactive mode
     ScreenState current_screen = SCREEN_WELCOME;
 
+    // ui_refresh_hz caps how often the progress display is redrawn
+    int refresh_hz = (int)config_get_long("ui_refresh_hz", 10);
+    UIScheduler scheduler;
+    ui_scheduler_init(&scheduler, refresh_hz, UI_PROGRESS_BAR_WIDTH);
+
+    // The visualizer animates at the refresh rate and may use 1% of a core
+    Visualizer visualizer;
+    visualizer_init(&visualizer, refresh_hz > 0 && config_get_long("visualizer", 1) != 0, refresh_hz, 1.0);
+    ui_screens_set_visualizer(&visualizer);
+
+    UIQueueView queue_view;
+    ui_queue_view_init(&queue_view);
+
     // If path provided as argument, play file or load folder as playlist.
-    if (argc > 1)
+    if (path_arg)
     {
         char filepath[512];
-        strncpy(filepath, argv[1], sizeof(filepath) - 1);
-        filepath[sizeof(filepath) - 1] = '\0';
-        strip_quotes(filepath);
-        unescape_path(filepath);
+        normalize_path_arg(path_arg, filepath, sizeof(filepath));
 
         ui_screen_loading(ui_buf, filepath);
         ui_buffer_render(ui_buf);
@@ -106,8 +683,9 @@ int main(int argc, char *argv[])
                 return 1;
             }
 
+            enqueue_paths(controller, paths + 1, path_count - 1);
             current_screen = SCREEN_QUEUE;
-            ui_screen_queue(ui_buf, app_controller_get_queue(controller),
+            ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
                             app_controller_get_repeat_symbol(controller),
                             app_controller_get_repeat_label(controller));
         }
@@ -122,6 +700,7 @@ int main(int argc, char *argv[])
                 return 1;
             }
 
+            enqueue_paths(controller, paths + 1, path_count - 1);
             current_screen = SCREEN_PLAYING;
             ui_screen_playing(ui_buf, player, show_controls,
                               app_controller_get_repeat_symbol(controller),
@@ -138,11 +717,87 @@ int main(int argc, char *argv[])
 
     ui_buffer_render(ui_buf);
 
+    PlayerEvents events = {player, controller, 0, 0};
+    terminal_set_read_hook(player_get_event_fd(player), player_events_on_ready, &events);
+
+    // Lets a second `walcman file` hand its files to this instance; without
+    // it (e.g. another instance already listens) everything else still works
+    ControlServer *server = control_server_open(controller, NULL);
+    struct pollfd *fds = NULL;
+    size_t fds_capacity = 0;
+
     terminal_raw_mode();
 
     while (running)
     {
-        int ch = terminal_read_char();
+        // stdin, the player's event pipe, then the control server's descriptors
+        size_t needed = 2 + control_server_pollfd_count(server);
+        if (needed > fds_capacity)
+        {
+            struct pollfd *grown = (struct pollfd *)realloc(fds, needed * sizeof(struct pollfd));
+            if (!grown)
+                break;
+            fds = grown;
+            fds_capacity = needed;
+        }
+
+        fds[0].fd = STDIN_FILENO;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = player_get_event_fd(player);
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        size_t control_count = control_server_fill_pollfds(server, fds + 2, fds_capacity - 2);
+
+        // Sleep until a key arrives, the audio thread reports a track end,
+        // or the progress display is due to change
+        int live = (current_screen == SCREEN_PLAYING || current_screen == SCREEN_QUEUE) &&
+                   player_get_state(player) == STATE_PLAYING;
+
+        // Spectrum work only happens while it is on screen
+        visualizer_set_active(&visualizer, player, live && current_screen == SCREEN_PLAYING);
+        ui_scheduler_set_continuous(&scheduler, visualizer.active);
+        int timeout = ui_scheduler_timeout(&scheduler,
+                                           live ? player_get_position(player) : 0.0f,
+                                           live ? player_get_duration(player) : 0.0f,
+                                           live);
+
+        int ready = poll(fds, 2 + control_count, timeout);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        if (ready == 0)
+        {
+            // Timed out: redraw only if the shown second or bar cell moved
+            if (live && ui_scheduler_begin_frame(&scheduler, player_get_position(player), player_get_duration(player)))
+            {
+                if (current_screen == SCREEN_QUEUE)
+                {
+                    ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
+                                    app_controller_get_repeat_symbol(controller),
+                                    app_controller_get_repeat_label(controller));
+                }
+                else
+                {
+                    visualizer_update(&visualizer, player);
+                    ui_screen_playing(ui_buf, player, show_controls,
+                                      app_controller_get_repeat_symbol(controller),
+                                      app_controller_get_repeat_label(controller));
+                }
+                ui_buffer_render(ui_buf);
+                ui_scheduler_end_frame(&scheduler);
+            }
+            continue;
+        }
+
+        if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL))
+            running = 0;
+
+        int ch = (fds[0].revents & POLLIN) ? terminal_read_char() : -1;
         if (ch != -1)
         {
             // Handle input based on current screen
@@ -223,7 +878,8 @@ int main(int argc, char *argv[])
                 else if (action == INPUT_ACTION_SHOW_QUEUE)
                 {
                     current_screen = SCREEN_QUEUE;
-                    ui_screen_queue(ui_buf, app_controller_get_queue(controller),
+                    ui_queue_view_follow(&queue_view);
+                    ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
                                     app_controller_get_repeat_symbol(controller),
                                     app_controller_get_repeat_label(controller));
                     ui_buffer_render(ui_buf);
@@ -249,7 +905,7 @@ int main(int argc, char *argv[])
                             if (loaded > 0)
                             {
                                 current_screen = SCREEN_QUEUE;
-                                ui_screen_queue(ui_buf, app_controller_get_queue(controller),
+                                ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
                                                 app_controller_get_repeat_symbol(controller),
                                                 app_controller_get_repeat_label(controller));
                                 ui_buffer_render(ui_buf);
@@ -257,6 +913,7 @@ int main(int argc, char *argv[])
                             else
                             {
                                 error_print(ERR_FILE_LOAD, "Could not load playable files from folder");
+                                ui_invalidate();
                                 ui_screen_welcome(ui_buf, show_controls,
                                                   app_controller_get_repeat_symbol(controller),
                                                   app_controller_get_shuffle_symbol(controller),
@@ -277,6 +934,7 @@ int main(int argc, char *argv[])
                             else
                             {
                                 error_print(ERR_FILE_LOAD, filepath);
+                                ui_invalidate();
                                 ui_screen_welcome(ui_buf, show_controls,
                                                   app_controller_get_repeat_symbol(controller),
                                                   app_controller_get_shuffle_symbol(controller),
@@ -316,13 +974,14 @@ int main(int argc, char *argv[])
                         if (loaded > 0)
                         {
                             current_screen = SCREEN_QUEUE;
-                            ui_screen_queue(ui_buf, app_controller_get_queue(controller),
+                            ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
                                             app_controller_get_repeat_symbol(controller),
                                             app_controller_get_repeat_label(controller));
                         }
                         else
                         {
                             error_print(ERR_FILE_LOAD, "Could not load playable files from folder");
+                            ui_invalidate();
                             current_screen = SCREEN_WELCOME;
                             ui_screen_welcome(ui_buf, show_controls,
                                               app_controller_get_repeat_symbol(controller),
@@ -359,7 +1018,7 @@ int main(int argc, char *argv[])
                         {
                             if (current_screen == SCREEN_QUEUE)
                             {
-                                ui_screen_queue(ui_buf, app_controller_get_queue(controller),
+                                ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
                                                 app_controller_get_repeat_symbol(controller),
                                                 app_controller_get_repeat_label(controller));
                             }
@@ -375,6 +1034,7 @@ int main(int argc, char *argv[])
                         else
                         {
                             error_print(ERR_FILE_LOAD, filepath);
+                            ui_invalidate();
                             if (player->is_playing)
                             {
                                 ui_screen_playing(ui_buf, player, show_controls,
@@ -398,7 +1058,7 @@ int main(int argc, char *argv[])
 
                     if (current_screen == SCREEN_QUEUE)
                     {
-                        ui_screen_queue(ui_buf, app_controller_get_queue(controller),
+                        ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
                                         app_controller_get_repeat_symbol(controller),
                                         app_controller_get_repeat_label(controller));
                     }
@@ -423,7 +1083,7 @@ int main(int argc, char *argv[])
 
                     if (current_screen == SCREEN_QUEUE)
                     {
-                        ui_screen_queue(ui_buf, app_controller_get_queue(controller),
+                        ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
                                         app_controller_get_repeat_symbol(controller),
                                         app_controller_get_repeat_label(controller));
                     }
@@ -448,7 +1108,7 @@ int main(int argc, char *argv[])
 
                     if (current_screen == SCREEN_QUEUE)
                     {
-                        ui_screen_queue(ui_buf, app_controller_get_queue(controller),
+                        ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
                                         app_controller_get_repeat_symbol(controller),
                                         app_controller_get_repeat_label(controller));
                     }
@@ -473,7 +1133,7 @@ int main(int argc, char *argv[])
 
                     if (current_screen == SCREEN_QUEUE)
                     {
-                        ui_screen_queue(ui_buf, app_controller_get_queue(controller),
+                        ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
                                         app_controller_get_repeat_symbol(controller),
                                         app_controller_get_repeat_label(controller));
                     }
@@ -492,6 +1152,29 @@ int main(int argc, char *argv[])
                     }
                     ui_buffer_render(ui_buf);
                 }
+                else if (current_screen == SCREEN_QUEUE &&
+                         (action == INPUT_ACTION_SCROLL_DOWN || action == INPUT_ACTION_SCROLL_UP ||
+                          action == INPUT_ACTION_PAGE_DOWN || action == INPUT_ACTION_PAGE_UP ||
+                          action == INPUT_ACTION_SCROLL_CURRENT))
+                {
+                    long page = queue_view.rows > 2 ? (long)(queue_view.rows / 2) : 1;
+
+                    if (action == INPUT_ACTION_SCROLL_DOWN)
+                        ui_queue_view_scroll(&queue_view, 1);
+                    else if (action == INPUT_ACTION_SCROLL_UP)
+                        ui_queue_view_scroll(&queue_view, -1);
+                    else if (action == INPUT_ACTION_PAGE_DOWN)
+                        ui_queue_view_scroll(&queue_view, page);
+                    else if (action == INPUT_ACTION_PAGE_UP)
+                        ui_queue_view_scroll(&queue_view, -page);
+                    else
+                        ui_queue_view_follow(&queue_view);
+
+                    ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
+                                    app_controller_get_repeat_symbol(controller),
+                                    app_controller_get_repeat_label(controller));
+                    ui_buffer_render(ui_buf);
+                }
                 else
                 {
                     // Let the normal action handler deal with it
@@ -502,7 +1185,7 @@ int main(int argc, char *argv[])
                     {
                         if (current_screen == SCREEN_QUEUE)
                         {
-                            ui_screen_queue(ui_buf, app_controller_get_queue(controller),
+                            ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
                                             app_controller_get_repeat_symbol(controller),
                                             app_controller_get_repeat_label(controller));
                         }
@@ -524,17 +1207,64 @@ int main(int argc, char *argv[])
                 }
             }
         }
-        else
+
+        if (fds[1].revents & POLLIN)
+            player_events_handle(&events);
+
+        // Also picks up events handled while a prompt was open
+        if (events.track_ended || events.load_result != 0)
+        {
+            int load_result = events.load_result;
+            events.track_ended = 0;
+            events.load_result = 0;
+
+            if (load_result != 0 && exit_on_load_failure)
+            {
+                exit_on_load_failure = 0;
+                if (load_result < 0)
+                {
+                    // Same as before loading went async: a bad path argument quits
+                    exit_code = 1;
+                    break;
+                }
+            }
+
+            if (current_screen == SCREEN_QUEUE)
+            {
+                ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
+                                app_controller_get_repeat_symbol(controller),
+                                app_controller_get_repeat_label(controller));
+                ui_buffer_render(ui_buf);
+            }
+            else if (current_screen == SCREEN_PLAYING)
+            {
+                ui_screen_playing(ui_buf, player, show_controls,
+                                  app_controller_get_repeat_symbol(controller),
+                                  app_controller_get_repeat_label(controller));
+                ui_buffer_render(ui_buf);
+            }
+        }
+
+        if (control_count > 0)
         {
-            // Check if song has ended
-            PlayerState state = player_get_state(player);
-            if (state == STATE_PLAYING && player_has_finished(player))
+            int requests = 0;
+            for (size_t i = 0; i < control_count; i++)
+                requests |= fds[2 + i].revents & POLLIN;
+
+            if (control_server_dispatch(server, fds + 2, control_count))
+                running = 0;
+
+            // Commands from other processes change what the screen shows
+            if (running && requests)
             {
-                app_controller_handle_track_end(controller);
+                if (current_screen == SCREEN_WELCOME && player->is_playing)
+                    current_screen = SCREEN_PLAYING;
 
+                // Controller errors may have been printed over the screen
+                ui_invalidate();
                 if (current_screen == SCREEN_QUEUE)
                 {
-                    ui_screen_queue(ui_buf, app_controller_get_queue(controller),
+                    ui_screen_queue(ui_buf, app_controller_get_queue(controller), player, &queue_view,
                                     app_controller_get_repeat_symbol(controller),
                                     app_controller_get_repeat_label(controller));
                     ui_buffer_render(ui_buf);
@@ -547,14 +1277,30 @@ int main(int argc, char *argv[])
                     ui_buffer_render(ui_buf);
                 }
             }
-            usleep(INPUT_POLL_INTERVAL_US);
         }
     }
 
+    free(fds);
+    control_server_close(server);
+    terminal_set_read_hook(-1, NULL, NULL);
+    visualizer_set_active(&visualizer, player, 0);
     terminal_normal_mode();
+
+    if (exit_code != 0)
+    {
+        // Keep the load error on screen
+        ui_buffer_destroy(ui_buf);
+        app_controller_destroy(controller);
+        player_destroy(player);
+        return exit_code;
+    }
+
     ui_clear_screen();
     printf("Exiting walcman...\n");
 
+    if (show_stats)
+        print_stats(player, controller, &scheduler, &visualizer);
+
     ui_buffer_destroy(ui_buf);
     app_controller_destroy(controller);
     player_destroy(player);
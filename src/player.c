@@ -4,42 +4,2161 @@
  * Wraps the miniaudio library to provide simple audio playback functionality.
  * Manages the ma_engine and ma_sound objects, handling initialization,
  * playback control, and resource cleanup.
+ *
+ * Gapless playback: the next track is preloaded into a second ma_sound and
+ * scheduled on the engine clock to start on the exact frame the current
+ * track runs out. The schedule is computed on the audio thread (engine
+ * onProcess callback), where the engine time and the sound cursor are
+ * consistent with each other.
+ *
+ * The output device only runs while something is audible: it is started on
+ * play/resume and stopped on pause/stop, so an idle player costs no audio
+ * thread wakeups.
+ *
+ * Crossfade: with crossfade_seconds set, the same schedule starts the next
+ * track that much earlier and both sounds mix for the overlap. The gain
+ * ramps are miniaudio's per-sound faders, so they follow the engine clock
+ * to the frame: the next track fades in from its first frame, and the
+ * current one fades out from the scheduled start until its data runs out.
+ * Its end callback then fires exactly when the fade-in completes, and the
+ * main loop advances as it does for gapless playback. The next track is
+ * preloaded when the current one starts, so its decoder is well ahead by
+ * the time the overlap begins.
+ *
+ * Track cache: tracks that are not streamed are loaded into memory whole
+ * by the resource manager, which shares that buffer between sounds of the
+ * same path but frees it with the last one. The cache keeps an extra
+ * reference on the buffers of recently loaded tracks (including the
+ * preloaded next one), so stepping back and forth does not touch the disk
+ * again. Entries are keyed on path, mtime and size, and the least recently
+ * loaded ones are dropped when the configured memory budget is exceeded.
+ *
+ * Track ends are reported through a self-pipe written from the sound end
+ * callback, so the main loop can sleep in poll() until something happens.
+ *
+ * Telemetry: the device callback times itself, meters the mixed output and
+ * reads the current track's cursor, then publishes the lot as a seqlock of
+ * atomic words. Readers retry instead of locking, and the audio thread only
+ * ever try-locks current_lock, so it never waits on the UI.
+ *
+ * Visualizer tap: every sound feeds a passthrough node in front of the
+ * endpoint. While the tap is enabled the node mixes what passes through
+ * down to mono and pushes it into a single-producer/single-consumer ring
+ * that the UI drains; otherwise it only costs a flag check per period.
+ *
+ * Background loading: miniaudio opens the file and parses its header on the
+ * calling thread even for MA_SOUND_FLAG_ASYNC sounds, so a loader thread
+ * owns that part and the resource manager job threads do the decoding.
+ * Only the newest request matters; every request bumps a generation counter
+ * and results of older generations are thrown away when they complete.
+ * Finished loads are announced through the same self-pipe.
+ *
+ * Lazy engine: ma_engine_init() enumerates and opens the output device,
+ * which can take a noticeable fraction of a second with PulseAudio. The
+ * loader thread does it first thing instead, so player_create() returns at
+ * once and the first frame is drawn while the device comes up. Anything
+ * that needs the engine on the main thread waits for it there; background
+ * loads queue behind it on the loader thread anyway.
+ *
+ * Seek indexes: without a seek table, miniaudio's MP3 decoder seeks by
+ * decoding every frame from the start of the file, and the resource manager
+ * gives no way to ask for one. MP3s are therefore opened through a small
+ * decoding backend of our own that wraps ma_mp3 and binds a table of seek
+ * points once one exists. The tables are built on a background thread the
+ * first time a file plays (a header-only walk over the file) and kept in
+ * ~/.config/walcman/seek/. Decoders only see a byte stream, so files are
+ * matched to their tables by size and a hash of their first and last bytes.
+ * FLAC needs none of this: it seeks through its SEEKTABLE block or a binary
+ * search over frame headers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+// Streamed sounds keep two decoded pages resident; keep them small so long
+// files cost a few hundred KB regardless of their length.
+#define MA_RESOURCE_MANAGER_PAGE_SIZE_IN_MILLISECONDS 500
+
+#define MINIAUDIO_IMPLEMENTATION
+#include "miniaudio.h"
+#include "player.h"
+#include "error.h"
+#include "config.h"
+#include "util.h"
+
+#define PLAYER_STREAM_THRESHOLD_MB 16 // Stream files at least this large by default
+#define PLAYER_TAP_FRAMES 8192        // Visualizer ring capacity (mono frames)
+#define PLAYER_CROSSFADE_MAX_SECONDS 12.0
+#define PLAYER_CACHE_MB 64            // Default track cache budget
+#define PLAYER_CACHE_ENTRIES 32       // Most tracks the cache holds at once
+#define PLAYER_SEEK_INDEX_MS 500      // Audio between two MP3 seek points
+#define PLAYER_SEEK_KEY_BYTES 4096    // Bytes hashed at each end of a file to recognize it
+#define PLAYER_SEEK_INDEXES 64        // Unused seek indexes kept in memory
+#define PLAYER_SEEK_DIR "seek"        // Seek index directory in the config directory
+#define PLAYER_SEEK_MAGIC "WSEEK001"  // First bytes of a seek index file
+
+// Progress of the engine initialization on the loader thread
+typedef enum
+{
+    PLAYER_ENGINE_STARTING, // ma_engine_init() has not returned yet
+    PLAYER_ENGINE_READY,    // Engine and tap are usable
+    PLAYER_ENGINE_FAILED    // No audio output; every load fails
+} PlayerEngineState;
+
+// What a background load is for
+typedef enum
+{
+    PLAYER_LOAD_PLAY,   // Becomes the current track when done
+    PLAYER_LOAD_PRELOAD // Becomes the preloaded next track when done
+} PlayerLoadKind;
+
+// One background load request and its result
+typedef struct PlayerLoadJob
+{
+    char *path;              // File to load (owned copy)
+    unsigned int generation; // Request generation, see load_generation
+    ma_sound *sound;         // Loaded sound, NULL if loading failed
+    int stream;              // 1 if the sound is streamed from disk
+} PlayerLoadJob;
+
+// A file whose in-memory buffer the track cache keeps alive
+typedef struct PlayerCacheEntry
+{
+    char *path;          // Registered path (owned copy)
+    time_t mtime;        // File state when registered; a change makes the entry stale
+    off_t size;          // Bytes the resource manager holds for it
+    unsigned long used;  // cache_clock value of the last load
+} PlayerCacheEntry;
+
+// Identifies an encoded file by content, see player_seek_key()
+typedef struct PlayerSeekKey
+{
+    ma_uint64 size; // File size in bytes
+    ma_uint64 hash; // FNV-1a of the first and last PLAYER_SEEK_KEY_BYTES
+} PlayerSeekKey;
+
+// Seek points of one MP3, shared by every decoder of that file
+typedef struct PlayerSeekIndex
+{
+    struct PlayerSeekIndex *next;
+    PlayerSeekKey key;
+    ma_dr_mp3_seek_point *points; // Written once, before ready is set
+    ma_uint32 count;
+    ma_uint32 ready;   // 1 once points may be used (atomic)
+    int users;         // Decoders holding this entry, plus the builder (seek_lock)
+} PlayerSeekIndex;
+
+// A file waiting for its seek index
+typedef struct PlayerSeekJob
+{
+    struct PlayerSeekJob *next;
+    char *path;
+} PlayerSeekJob;
+
+// File header of a cached seek index, followed by the points
+typedef struct PlayerSeekFileHeader
+{
+    char magic[8];          // PLAYER_SEEK_MAGIC
+    ma_uint32 point_size;   // sizeof(ma_dr_mp3_seek_point) of the writer
+    ma_uint32 count;
+} PlayerSeekFileHeader;
+
+// What the audio thread publishes after every callback
+typedef struct PlayerTelemetryFrame
+{
+    PlayerTelemetry telemetry;
+    ma_uint32 serial; // current_serial of the track the cursor belongs to
+} PlayerTelemetryFrame;
+
+#define PLAYER_TELEMETRY_WORDS ((sizeof(PlayerTelemetryFrame) + sizeof(ma_uint32) - 1) / sizeof(ma_uint32))
+
+// Seqlock around the published frame
+typedef struct PlayerTelemetrySlot
+{
+    ma_uint32 sequence;                      // Odd while the audio thread is writing
+    ma_uint32 words[PLAYER_TELEMETRY_WORDS]; // PlayerTelemetryFrame, stored word by word
+} PlayerTelemetrySlot;
+
+// Passthrough node all sounds play through (see player_tap_process())
+typedef struct PlayerTapNode
+{
+    ma_node_base base; // Must be first
+    ma_pcm_rb ring;    // Mono samples for the UI; audio thread writes, UI reads
+    ma_uint32 enabled; // 1 while the UI wants samples (atomic)
+    ma_uint32 dropped; // Frames lost because the ring was full (atomic)
+} PlayerTapNode;
+
+// Internal miniaudio context (hidden from player.h)
+typedef struct
+{
+    ma_engine engine;      // miniaudio engine instance
+    ma_resource_manager resource_manager; // Owned here so it can use the MP3 backend below
+    ma_device device;      // Output device, created before the engine so its rate is known (unused offline)
+    ma_sound *current;     // Current sound, NULL while nothing is loaded
+    ma_sound *next;        // Preloaded next sound, NULL if none
+    int is_initialized;    // 1 if engine initialized successfully
+    int is_streaming;      // 1 if current sound is streamed from disk
+    int device_running;    // 1 while the output device is started
+    int offline;           // 1 for player_create_offline(): no device, player_render() pulls the mix
+    ma_uint32 offline_rate;
+    ma_uint32 offline_channels;
+    int next_streaming;    // 1 if the preloaded track is streamed
+    char *next_file;       // Path of the preloaded track (owned copy)
+    double crossfade_seconds; // Overlap between consecutive tracks, 0 for gapless
+    PlayerGainLookup gain_lookup; // Per-track gain source, NULL for unity gain (under load_lock)
+    void *gain_user_data;  // Passed to gain_lookup (under load_lock)
+    int gain_calls;        // Lookups running outside load_lock (under load_lock)
+    ma_spinlock arm_lock;  // Held while the next-track schedule is changed
+    ma_uint32 arm_pending; // 1 while the audio thread should schedule the next track
+    int event_pipe[2];     // Self-pipe signalled from the audio thread (read, write)
+    void *ended_sound;     // Sound whose end callback fired last (atomic), NULL once taken
+    ma_spinlock current_lock;  // Held while current changes (UI) or is read by the audio thread
+    ma_uint32 current_serial;  // Bumped whenever current changes (under current_lock)
+    PlayerTelemetrySlot telemetry;       // Written by the audio thread only
+    PlayerTelemetry telemetry_totals;    // Audio thread's running counters
+    ma_uint32 telemetry_serial;          // current_serial seen by the audio thread
+    PlayerTapNode tap;                   // Visualizer tap in front of the endpoint
+    int tap_initialized;                 // 1 once tap is part of the node graph
+    PlayerStats stats;     // Load counters
+
+    pthread_mutex_t cache_lock;   // Guards the track cache fields below (main and loader thread)
+    PlayerCacheEntry cache[PLAYER_CACHE_ENTRIES];
+    size_t cache_count;
+    long long cache_budget;       // Bytes; 0 disables the cache
+    long long cache_bytes;        // Sum of entry sizes
+    unsigned long cache_clock;    // Bumped on every cached load
+    unsigned long cache_hits;     // Loads served from the cache
+    unsigned long cache_misses;   // Loads that had to read the file
+
+    pthread_t seek_thread;        // Builds seek indexes
+    int seek_thread_started;      // 1 if seek_thread must be joined
+    pthread_mutex_t seek_lock;    // Guards the seek index fields below
+    pthread_cond_t seek_cond;     // Signalled when a job is posted or on shutdown
+    PlayerSeekIndex *seek_indexes; // Newest first
+    size_t seek_index_count;
+    PlayerSeekJob *seek_jobs;     // Newest first; only the newest few matter
+    ma_uint32 seek_quit;          // 1 when the seek thread should exit (atomic)
+    int seek_enabled;             // 0 if seek_index=0
+    unsigned long seek_built;     // Indexes built this session
+    unsigned long seek_loaded;    // Indexes read from disk this session
+
+    pthread_t loader;             // Background loader thread
+    pthread_mutex_t load_lock;    // Guards load_request, load_done, load_generation, loader_quit, engine_state, gain hook
+    pthread_cond_t load_cond;     // Signalled when a request is posted or on shutdown
+    pthread_cond_t engine_cond;   // Broadcast once engine_state leaves PLAYER_ENGINE_STARTING
+    pthread_cond_t gain_cond;     // Broadcast when gain_calls drops to 0
+    PlayerEngineState engine_state; // Set by the loader thread
+    int engine_ready;             // Main thread's copy: 1 once it saw PLAYER_ENGINE_READY
+    int engine_reported;          // 1 once an init failure was printed
+    PlayerLoadJob *load_request;  // Waiting for the loader thread
+    PlayerLoadJob *load_done;     // Finished, waiting for player_poll_load()
+    unsigned int load_generation; // Bumped by every request and cancellation
+    int loader_quit;              // 1 when the loader thread should exit
+    int load_pending;             // 1 until the newest request is collected (main thread)
+    PlayerLoadKind load_kind;     // What the newest request is for
+    char *load_file;              // Path of the newest request (owned copy)
+} PlayerContext;
+
+static char *player_strdup(const char *src)
+{
+    size_t len = strlen(src);
+    char *copy = (char *)malloc(len + 1);
+    if (!copy)
+        return NULL;
+
+    memcpy(copy, src, len + 1);
+    return copy;
+}
+
+/**
+ * Drop the cache's reference on an entry and remove it (cache_lock held)
+ */
+static void player_cache_remove(PlayerContext *ctx, size_t index)
+{
+    PlayerCacheEntry *entry = &ctx->cache[index];
+    ma_resource_manager_unregister_file(ma_engine_get_resource_manager(&ctx->engine), entry->path);
+    ctx->cache_bytes -= entry->size;
+    free(entry->path);
+
+    ctx->cache[index] = ctx->cache[--ctx->cache_count];
+}
+
+/**
+ * Find the entry for a path (cache_lock held)
+ * Returns its index, or -1 if the path is not cached
+ */
+static int player_cache_find(const PlayerContext *ctx, const char *filepath)
+{
+    for (size_t i = 0; i < ctx->cache_count; i++)
+    {
+        if (strcmp(ctx->cache[i].path, filepath) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+/**
+ * Find the least recently loaded entry (cache_lock held, cache not empty)
+ */
+static size_t player_cache_oldest(const PlayerContext *ctx)
+{
+    size_t oldest = 0;
+    for (size_t i = 1; i < ctx->cache_count; i++)
+    {
+        if (ctx->cache[i].used < ctx->cache[oldest].used)
+            oldest = i;
+    }
+    return oldest;
+}
+
+/**
+ * Count a load against the cache before the file is opened (any thread).
+ * An entry for an older version of the file is dropped, so the load reads
+ * the file again.
+ */
+static void player_cache_lookup(PlayerContext *ctx, const char *filepath)
+{
+    if (ctx->cache_budget <= 0)
+        return;
+
+    struct stat st;
+    int found = stat(filepath, &st) == 0;
+
+    pthread_mutex_lock(&ctx->cache_lock);
+    int index = player_cache_find(ctx, filepath);
+    if (index >= 0 && (!found || ctx->cache[index].mtime != st.st_mtime || ctx->cache[index].size != st.st_size))
+    {
+        player_cache_remove(ctx, (size_t)index);
+        index = -1;
+    }
+
+    if (index >= 0)
+        ctx->cache_hits++;
+    else
+        ctx->cache_misses++;
+    pthread_mutex_unlock(&ctx->cache_lock);
+}
+
+/**
+ * Keep the buffer of a freshly loaded sound alive for later loads, evicting
+ * the least recently loaded entries over the budget (any thread)
+ */
+static void player_cache_keep(PlayerContext *ctx, const char *filepath)
+{
+    if (ctx->cache_budget <= 0)
+        return;
+
+    struct stat st;
+    if (stat(filepath, &st) != 0)
+        return;
+
+    pthread_mutex_lock(&ctx->cache_lock);
+    int index = player_cache_find(ctx, filepath);
+    if (index < 0)
+    {
+        if (ctx->cache_count == PLAYER_CACHE_ENTRIES)
+            player_cache_remove(ctx, player_cache_oldest(ctx));
+
+        // The sound already holds the buffer, so this only takes a reference
+        char *path = player_strdup(filepath);
+        if (path && ma_resource_manager_register_file(ma_engine_get_resource_manager(&ctx->engine), path,
+                                                      MA_RESOURCE_MANAGER_DATA_SOURCE_FLAG_ASYNC) == MA_SUCCESS)
+        {
+            index = (int)ctx->cache_count++;
+            ctx->cache[index].path = path;
+            ctx->cache[index].mtime = st.st_mtime;
+            ctx->cache[index].size = st.st_size;
+            ctx->cache_bytes += st.st_size;
+        }
+        else
+        {
+            free(path);
+        }
+    }
+
+    if (index >= 0)
+        ctx->cache[index].used = ++ctx->cache_clock;
+
+    // A track larger than the whole budget evicts itself
+    while (ctx->cache_bytes > ctx->cache_budget && ctx->cache_count > 0)
+        player_cache_remove(ctx, player_cache_oldest(ctx));
+    pthread_mutex_unlock(&ctx->cache_lock);
+}
+
+/**
+ * Release every cache entry (engine still initialized)
+ */
+static void player_cache_clear(PlayerContext *ctx)
+{
+    pthread_mutex_lock(&ctx->cache_lock);
+    while (ctx->cache_count > 0)
+        player_cache_remove(ctx, ctx->cache_count - 1);
+    pthread_mutex_unlock(&ctx->cache_lock);
+}
+
+// Random access to an encoded file, however it is held
+typedef struct PlayerBytes
+{
+    ma_read_proc read;
+    ma_seek_proc seek;
+    void *user_data;
+    ma_uint64 size;
+} PlayerBytes;
+
+// An in-memory file read through PlayerBytes
+typedef struct PlayerMemoryReader
+{
+    const ma_uint8 *data;
+    size_t size;
+    size_t cursor;
+} PlayerMemoryReader;
+
+// A file on disk read by the seek index thread
+typedef struct PlayerFileReader
+{
+    FILE *file;
+    PlayerContext *ctx; // Reads fail once the player shuts down
+} PlayerFileReader;
+
+// Decoding backend object: ma_mp3 plus the seek index it may bind
+typedef struct PlayerMp3Source
+{
+    ma_data_source_base base; // Must be first
+    ma_mp3 mp3;
+    PlayerContext *ctx;
+    PlayerSeekIndex *index; // NULL if the file could not be identified
+    int bound;              // 1 once index is bound (decoding thread only)
+    ma_uint64 length;       // PCM frames, counted once when opened
+} PlayerMp3Source;
+
+static ma_result player_memory_read(void *user_data, void *out, size_t size, size_t *read)
+{
+    PlayerMemoryReader *reader = (PlayerMemoryReader *)user_data;
+    size_t available = reader->size - reader->cursor;
+    if (size > available)
+        size = available;
+
+    memcpy(out, reader->data + reader->cursor, size);
+    reader->cursor += size;
+    *read = size;
+    return size > 0 ? MA_SUCCESS : MA_AT_END;
+}
+
+static ma_result player_memory_seek(void *user_data, ma_int64 offset, ma_seek_origin origin)
+{
+    PlayerMemoryReader *reader = (PlayerMemoryReader *)user_data;
+    ma_int64 base = origin == ma_seek_origin_start ? 0
+                    : origin == ma_seek_origin_end ? (ma_int64)reader->size
+                                                   : (ma_int64)reader->cursor;
+    if (base + offset < 0 || base + offset > (ma_int64)reader->size)
+        return MA_BAD_SEEK;
+
+    reader->cursor = (size_t)(base + offset);
+    return MA_SUCCESS;
+}
+
+static ma_result player_file_read(void *user_data, void *out, size_t size, size_t *read)
+{
+    PlayerFileReader *reader = (PlayerFileReader *)user_data;
+
+    // Cuts a long scan short at shutdown; the decoder sees an end of file
+    if (ma_atomic_load_32(&reader->ctx->seek_quit))
+    {
+        *read = 0;
+        return MA_CANCELLED;
+    }
+
+    *read = fread(out, 1, size, reader->file);
+    return *read > 0 ? MA_SUCCESS : MA_AT_END;
+}
+
+static ma_result player_file_seek(void *user_data, ma_int64 offset, ma_seek_origin origin)
+{
+    PlayerFileReader *reader = (PlayerFileReader *)user_data;
+    int whence = origin == ma_seek_origin_start ? SEEK_SET : origin == ma_seek_origin_end ? SEEK_END : SEEK_CUR;
+    return fseeko(reader->file, (off_t)offset, whence) == 0 ? MA_SUCCESS : MA_BAD_SEEK;
+}
+
+static ma_result player_file_tell(void *user_data, ma_int64 *cursor)
+{
+    PlayerFileReader *reader = (PlayerFileReader *)user_data;
+    off_t position = ftello(reader->file);
+    if (position < 0)
+        return MA_ERROR;
+
+    *cursor = (ma_int64)position;
+    return MA_SUCCESS;
+}
+
+/**
+ * Measure a stream and rewind it
+ * Returns 0 on success, -1 if it cannot seek
+ */
+static int player_bytes_init(PlayerBytes *bytes, ma_read_proc read, ma_seek_proc seek, ma_tell_proc tell, void *user_data)
+{
+    ma_int64 end = 0;
+    bytes->read = read;
+    bytes->seek = seek;
+    bytes->user_data = user_data;
+
+    if (seek(user_data, 0, ma_seek_origin_end) != MA_SUCCESS || tell(user_data, &end) != MA_SUCCESS || end < 0)
+        return -1;
+
+    bytes->size = (ma_uint64)end;
+    return seek(user_data, 0, ma_seek_origin_start) == MA_SUCCESS ? 0 : -1;
+}
+
+/**
+ * Read up to size bytes at offset
+ * Returns the number of bytes read
+ */
+static size_t player_bytes_read_at(const PlayerBytes *bytes, ma_uint64 offset, void *out, size_t size)
+{
+    if (bytes->seek(bytes->user_data, (ma_int64)offset, ma_seek_origin_start) != MA_SUCCESS)
+        return 0;
+
+    size_t total = 0;
+    while (total < size)
+    {
+        size_t read = 0;
+        if (bytes->read(bytes->user_data, (ma_uint8 *)out + total, size - total, &read) != MA_SUCCESS || read == 0)
+            break;
+        total += read;
+    }
+    return total;
+}
+
+/**
+ * Check for an MPEG audio layer III frame header
+ */
+static int player_mp3_frame_header(const ma_uint8 *header)
+{
+    return header[0] == 0xFF && (header[1] & 0xE0) == 0xE0 &&
+           ((header[1] >> 3) & 3) != 1 &&  // Version not reserved
+           ((header[1] >> 1) & 3) == 1 &&  // Layer III
+           (header[2] >> 4) != 0xF &&      // Valid bitrate
+           ((header[2] >> 2) & 3) != 3;    // Valid sample rate
+}
+
+/**
+ * Find the first MP3 frame: a frame header at the start, or right after an
+ * ID3v2 tag (allowing some padding)
+ * Returns 1 and its offset if found, 0 otherwise
+ */
+static int player_mp3_first_frame(const PlayerBytes *bytes, ma_uint64 *out_offset)
+{
+    ma_uint8 header[10];
+    if (player_bytes_read_at(bytes, 0, header, sizeof(header)) != sizeof(header))
+        return 0;
+
+    if (memcmp(header, "ID3", 3) != 0)
+    {
+        *out_offset = 0;
+        return player_mp3_frame_header(header);
+    }
+
+    ma_uint64 offset = 10 + (((ma_uint64)(header[6] & 0x7F) << 21) | ((ma_uint64)(header[7] & 0x7F) << 14) |
+                             ((ma_uint64)(header[8] & 0x7F) << 7) | (ma_uint64)(header[9] & 0x7F));
+    if (header[5] & 0x10)
+        offset += 10; // Footer
+
+    ma_uint8 window[1024];
+    size_t read = player_bytes_read_at(bytes, offset, window, sizeof(window));
+    for (size_t i = 0; i + 4 <= read; i++)
+    {
+        if (player_mp3_frame_header(window + i))
+        {
+            *out_offset = offset + i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Check whether a file is an MP3. Anything else is left to the stock decoders.
+ */
+static int player_mp3_sniff(const PlayerBytes *bytes)
+{
+    ma_uint64 offset = 0;
+    return player_mp3_first_frame(bytes, &offset);
+}
+
+/**
+ * Estimate an MP3's length from its first frame alone: the frame count of a
+ * Xing/Info header if it has one, otherwise its bitrate applied to the whole
+ * file (exact for constant bitrate files)
+ * Returns the length in seconds, or a negative value if it is not an MP3
+ */
+static double player_mp3_estimate_seconds(const PlayerBytes *bytes)
+{
+    static const unsigned kbps_table[2][15] = {
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320}, // MPEG-1
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},     // MPEG-2 and 2.5
+    };
+    static const unsigned rate_table[3] = {44100, 48000, 32000}; // MPEG-1; halved for 2, quartered for 2.5
+
+    ma_uint64 offset = 0;
+    ma_uint8 frame[4 + 32 + 12]; // Header, longest side info, Xing tag, flags and frame count
+    if (!player_mp3_first_frame(bytes, &offset))
+        return -1.0;
+
+    size_t read = player_bytes_read_at(bytes, offset, frame, sizeof(frame));
+    if (read < 4)
+        return -1.0;
+
+    int version = (frame[1] >> 3) & 3;
+    int mpeg1 = version == 3;
+    unsigned rate = rate_table[(frame[2] >> 2) & 3] >> (mpeg1 ? 0 : version == 2 ? 1 : 2);
+    int mono = ((frame[3] >> 6) & 3) == 3;
+    size_t side = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+
+    const ma_uint8 *tag = frame + 4 + side;
+    if (read >= 4 + side + 12 && (memcmp(tag, "Xing", 4) == 0 || memcmp(tag, "Info", 4) == 0) && (tag[7] & 1))
+    {
+        ma_uint32 frames = ((ma_uint32)tag[8] << 24) | ((ma_uint32)tag[9] << 16) | ((ma_uint32)tag[10] << 8) | tag[11];
+        return (double)frames * (mpeg1 ? 1152 : 576) / rate;
+    }
+
+    unsigned kbps = kbps_table[mpeg1 ? 0 : 1][frame[2] >> 4];
+    if (kbps == 0)
+        return -1.0; // Free format
+    return (double)(bytes->size - offset) * 8.0 / (kbps * 1000.0);
+}
+
+/**
+ * Decide whether a file should be streamed instead of loaded into memory.
+ * Streaming is used when the file size reaches stream_threshold_mb, or when
+ * stream_threshold_minutes is set and the track's length reaches it.
+ */
+static int player_should_stream(PlayerContext *ctx, const char *filepath)
+{
+    struct stat st;
+    if (stat(filepath, &st) != 0)
+        return 0;
+
+    long threshold_mb = config_get_long("stream_threshold_mb", PLAYER_STREAM_THRESHOLD_MB);
+    if (threshold_mb >= 0 && (long long)st.st_size >= (long long)threshold_mb * 1024 * 1024)
+        return 1;
+
+    long threshold_minutes = config_get_long("stream_threshold_minutes", 0);
+    if (threshold_minutes <= 0)
+        return 0;
+
+    // Asking a decoder for the length of an MP3 without a Xing header walks
+    // the whole file, so MP3s are judged by their first frame
+    PlayerFileReader reader = {fopen(filepath, "rb"), ctx};
+    if (!reader.file)
+        return 0;
+
+    PlayerBytes bytes;
+    double seconds = -1.0;
+    if (player_bytes_init(&bytes, player_file_read, player_file_seek, player_file_tell, &reader) == 0)
+        seconds = player_mp3_estimate_seconds(&bytes);
+    fclose(reader.file);
+
+    if (seconds >= 0.0)
+        return seconds >= threshold_minutes * 60.0;
+
+    // Other formats keep their length in the header (WAV, FLAC) or last page (Ogg)
+    ma_decoder decoder;
+    if (ma_decoder_init_file(filepath, NULL, &decoder) != MA_SUCCESS)
+        return 0;
+
+    ma_uint64 length = 0;
+    int stream = 0;
+    if (ma_decoder_get_length_in_pcm_frames(&decoder, &length) == MA_SUCCESS &&
+        decoder.outputSampleRate > 0)
+    {
+        stream = length / decoder.outputSampleRate >= (ma_uint64)threshold_minutes * 60;
+    }
+
+    ma_decoder_uninit(&decoder);
+    return stream;
+}
+
+/**
+ * Identify a file by its size and a hash of its first and last bytes.
+ * Tracks of one album often share their leading tag (cover art included),
+ * but not their last frames.
+ * Returns 0 on success, -1 on a read error
+ */
+static int player_seek_key(const PlayerBytes *bytes, PlayerSeekKey *out)
+{
+    ma_uint8 buffer[PLAYER_SEEK_KEY_BYTES];
+    size_t span = bytes->size < PLAYER_SEEK_KEY_BYTES ? (size_t)bytes->size : PLAYER_SEEK_KEY_BYTES;
+    ma_uint64 offsets[2] = {0, bytes->size - span};
+    ma_uint64 hash = 14695981039346656037ULL;
+
+    for (int part = 0; part < 2; part++)
+    {
+        if (player_bytes_read_at(bytes, offsets[part], buffer, span) != span)
+            return -1;
+
+        for (size_t i = 0; i < span; i++)
+        {
+            hash ^= buffer[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    out->size = bytes->size;
+    out->hash = hash;
+    return 0;
+}
+
+/**
+ * Find or create the index entry for a file and hold it (any thread but
+ * the audio thread)
+ * Returns the entry, or NULL if out of memory
+ */
+static PlayerSeekIndex *player_seek_acquire(PlayerContext *ctx, const PlayerSeekKey *key)
+{
+    pthread_mutex_lock(&ctx->seek_lock);
+
+    PlayerSeekIndex *index = ctx->seek_indexes;
+    while (index && (index->key.size != key->size || index->key.hash != key->hash))
+        index = index->next;
+
+    if (!index)
+    {
+        index = (PlayerSeekIndex *)calloc(1, sizeof(PlayerSeekIndex));
+        if (index)
+        {
+            index->key = *key;
+            index->next = ctx->seek_indexes;
+            ctx->seek_indexes = index;
+            ctx->seek_index_count++;
+        }
+    }
+
+    if (index)
+        index->users++;
+
+    pthread_mutex_unlock(&ctx->seek_lock);
+    return index;
+}
+
+/**
+ * Let go of an entry, dropping the oldest unused ones beyond
+ * PLAYER_SEEK_INDEXES (they are read back from disk when needed again)
+ */
+static void player_seek_release(PlayerContext *ctx, PlayerSeekIndex *index)
+{
+    pthread_mutex_lock(&ctx->seek_lock);
+    index->users--;
+
+    while (ctx->seek_index_count > PLAYER_SEEK_INDEXES)
+    {
+        PlayerSeekIndex **oldest = NULL;
+        for (PlayerSeekIndex **link = &ctx->seek_indexes; *link; link = &(*link)->next)
+        {
+            if ((*link)->users == 0)
+                oldest = link;
+        }
+        if (!oldest)
+            break;
+
+        PlayerSeekIndex *unused = *oldest;
+        *oldest = unused->next;
+        ctx->seek_index_count--;
+        free(unused->points);
+        free(unused);
+    }
+
+    pthread_mutex_unlock(&ctx->seek_lock);
+}
+
+/**
+ * Make points the entry's seek table (seek thread only, once per entry)
+ */
+static void player_seek_publish(PlayerSeekIndex *index, ma_dr_mp3_seek_point *points, ma_uint32 count)
+{
+    index->points = points;
+    index->count = count;
+    ma_atomic_store_32(&index->ready, 1);
+}
+
+/**
+ * Build the path of a cached seek index
+ * Returns 0 on success, -1 if the config directory is unavailable
+ */
+static int player_seek_file_path(const PlayerSeekKey *key, char *out, size_t out_size)
+{
+    char dir[512];
+    if (config_path(dir, sizeof(dir), PLAYER_SEEK_DIR) != 0)
+        return -1;
+
+    int written = snprintf(out, out_size, "%s/%016llx-%016llx.idx", dir,
+                           (unsigned long long)key->size, (unsigned long long)key->hash);
+    return written > 0 && (size_t)written < out_size ? 0 : -1;
+}
+
+/**
+ * Read an entry's table from disk (seek thread)
+ * Returns 0 on success, -1 if it is not cached or unreadable
+ */
+static int player_seek_load(PlayerSeekIndex *index)
+{
+    char path[600];
+    if (player_seek_file_path(&index->key, path, sizeof(path)) != 0)
+        return -1;
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return -1;
+
+    PlayerSeekFileHeader header;
+    ma_dr_mp3_seek_point *points = NULL;
+    int ok = fread(&header, sizeof(header), 1, file) == 1 &&
+             memcmp(header.magic, PLAYER_SEEK_MAGIC, sizeof(header.magic)) == 0 &&
+             header.point_size == sizeof(ma_dr_mp3_seek_point) &&
+             header.count > 0 && header.count <= index->key.size;
+
+    if (ok)
+    {
+        points = (ma_dr_mp3_seek_point *)malloc(header.count * sizeof(ma_dr_mp3_seek_point));
+        ok = points && fread(points, sizeof(ma_dr_mp3_seek_point), header.count, file) == header.count;
+    }
+    fclose(file);
+
+    if (!ok)
+    {
+        free(points);
+        return -1;
+    }
+
+    player_seek_publish(index, points, header.count);
+    return 0;
+}
+
+/**
+ * Write an entry's table to disk (seek thread); failures only cost a rebuild
+ */
+static void player_seek_save(const PlayerSeekIndex *index)
+{
+    char dir[512];
+    char path[600];
+    char tmp_path[610];
+    if (config_path(dir, sizeof(dir), PLAYER_SEEK_DIR) != 0 ||
+        player_seek_file_path(&index->key, path, sizeof(path)) != 0)
+        return;
+
+    config_ensure_dir();
+    mkdir(dir, 0755);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file)
+        return;
+
+    PlayerSeekFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PLAYER_SEEK_MAGIC, sizeof(header.magic));
+    header.point_size = sizeof(ma_dr_mp3_seek_point);
+    header.count = index->count;
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(index->points, sizeof(ma_dr_mp3_seek_point), index->count, file) == index->count;
+    if (fclose(file) != 0 || !ok || rename(tmp_path, path) != 0)
+        unlink(tmp_path);
+}
+
+/**
+ * Walk an MP3's frame headers and build its table (seek thread). Only
+ * headers are parsed, so this costs about as much as reading the file.
+ * Returns 0 on success, -1 on failure or shutdown
+ */
+static int player_seek_scan(PlayerContext *ctx, PlayerFileReader *reader, PlayerSeekIndex *index)
+{
+    if (fseeko(reader->file, 0, SEEK_SET) != 0)
+        return -1;
+
+    ma_decoding_backend_config config = ma_decoding_backend_config_init(ma_format_f32, 0);
+    ma_mp3 mp3;
+    if (ma_mp3_init(player_file_read, player_file_seek, player_file_tell, reader, &config, NULL, &mp3) != MA_SUCCESS)
+        return -1;
+
+    // A Xing/LAME header saves one pass over the file
+    ma_uint64 mp3_frames = 0;
+    ma_uint64 pcm_frames = mp3.dr.totalPCMFrameCount;
+    if (pcm_frames == MA_UINT64_MAX && !ma_dr_mp3_get_mp3_and_pcm_frame_count(&mp3.dr, &mp3_frames, &pcm_frames))
+        pcm_frames = 0;
+
+    ma_uint64 spacing = (ma_uint64)mp3.dr.sampleRate * PLAYER_SEEK_INDEX_MS / 1000;
+    ma_uint64 wanted = spacing > 0 ? pcm_frames / spacing : 0;
+    ma_uint32 count = wanted > 0xFFFFFF ? 0xFFFFFF : (ma_uint32)wanted;
+    if (count == 0)
+        count = 1;
+
+    ma_dr_mp3_seek_point *points = pcm_frames > 0 ? (ma_dr_mp3_seek_point *)malloc(count * sizeof(ma_dr_mp3_seek_point)) : NULL;
+    int ok = points && ma_dr_mp3_calculate_seek_points(&mp3.dr, &count, points) && count > 0 &&
+             !ma_atomic_load_32(&ctx->seek_quit);
+    ma_mp3_uninit(&mp3, NULL);
+
+    if (!ok)
+    {
+        free(points);
+        return -1;
+    }
+
+    player_seek_publish(index, points, count);
+    return 0;
+}
+
+/**
+ * Make sure a file's seek index is in memory (seek thread)
+ */
+static void player_seek_prepare(PlayerContext *ctx, const char *filepath)
+{
+    PlayerFileReader reader = {fopen(filepath, "rb"), ctx};
+    if (!reader.file)
+        return;
+
+    PlayerBytes bytes;
+    PlayerSeekKey key;
+    PlayerSeekIndex *index = NULL;
+    if (player_bytes_init(&bytes, player_file_read, player_file_seek, player_file_tell, &reader) == 0 &&
+        player_mp3_sniff(&bytes) && player_seek_key(&bytes, &key) == 0)
+    {
+        index = player_seek_acquire(ctx, &key);
+    }
+
+    if (index && !ma_atomic_load_32(&index->ready))
+    {
+        if (player_seek_load(index) == 0)
+        {
+            pthread_mutex_lock(&ctx->seek_lock);
+            ctx->seek_loaded++;
+            pthread_mutex_unlock(&ctx->seek_lock);
+        }
+        else if (player_seek_scan(ctx, &reader, index) == 0)
+        {
+            player_seek_save(index);
+            pthread_mutex_lock(&ctx->seek_lock);
+            ctx->seek_built++;
+            pthread_mutex_unlock(&ctx->seek_lock);
+        }
+    }
+
+    if (index)
+        player_seek_release(ctx, index);
+    fclose(reader.file);
+}
+
+/**
+ * Seek index thread: prepares the most recently played files first
+ */
+static void *player_seek_main(void *user_data)
+{
+    PlayerContext *ctx = (PlayerContext *)user_data;
+
+    pthread_mutex_lock(&ctx->seek_lock);
+    for (;;)
+    {
+        while (!ctx->seek_jobs && !ma_atomic_load_32(&ctx->seek_quit))
+            pthread_cond_wait(&ctx->seek_cond, &ctx->seek_lock);
+
+        if (ma_atomic_load_32(&ctx->seek_quit))
+            break;
+
+        PlayerSeekJob *job = ctx->seek_jobs;
+        ctx->seek_jobs = job->next;
+        pthread_mutex_unlock(&ctx->seek_lock);
+
+        player_seek_prepare(ctx, job->path);
+        free(job->path);
+        free(job);
+
+        pthread_mutex_lock(&ctx->seek_lock);
+    }
+    pthread_mutex_unlock(&ctx->seek_lock);
+
+    return NULL;
+}
+
+/**
+ * Ask for a file's seek index (loader or main thread)
+ */
+static void player_seek_request(PlayerContext *ctx, const char *filepath)
+{
+    if (!ctx->seek_thread_started)
+        return;
+
+    pthread_mutex_lock(&ctx->seek_lock);
+
+    PlayerSeekJob *job = ctx->seek_jobs;
+    while (job && strcmp(job->path, filepath) != 0)
+        job = job->next;
+
+    if (!job)
+    {
+        job = (PlayerSeekJob *)malloc(sizeof(PlayerSeekJob));
+        char *path = player_strdup(filepath);
+        if (job && path)
+        {
+            job->path = path;
+            job->next = ctx->seek_jobs;
+            ctx->seek_jobs = job;
+            pthread_cond_signal(&ctx->seek_cond);
+        }
+        else
+        {
+            free(job);
+            free(path);
+        }
+    }
+
+    pthread_mutex_unlock(&ctx->seek_lock);
+}
+
+static ma_result player_mp3_read(ma_data_source *data_source, void *out, ma_uint64 frame_count, ma_uint64 *frames_read)
+{
+    return ma_mp3_read_pcm_frames(&((PlayerMp3Source *)data_source)->mp3, out, frame_count, frames_read);
+}
+
+static ma_result player_mp3_seek(ma_data_source *data_source, ma_uint64 frame)
+{
+    PlayerMp3Source *source = (PlayerMp3Source *)data_source;
+
+    // Called on whichever thread decodes, so binding here never races a read
+    if (!source->bound && source->index && ma_atomic_load_32(&source->index->ready))
+    {
+        ma_dr_mp3_bind_seek_table(&source->mp3.dr, source->index->count, source->index->points);
+        source->bound = 1;
+    }
+
+    return ma_mp3_seek_to_pcm_frame(&source->mp3, frame);
+}
+
+static ma_result player_mp3_get_data_format(ma_data_source *data_source, ma_format *format, ma_uint32 *channels,
+                                            ma_uint32 *sample_rate, ma_channel *channel_map, size_t channel_map_cap)
+{
+    return ma_mp3_get_data_format(&((PlayerMp3Source *)data_source)->mp3, format, channels, sample_rate,
+                                  channel_map, channel_map_cap);
+}
+
+static ma_result player_mp3_get_cursor(ma_data_source *data_source, ma_uint64 *cursor)
+{
+    return ma_mp3_get_cursor_in_pcm_frames(&((PlayerMp3Source *)data_source)->mp3, cursor);
+}
+
+static ma_result player_mp3_get_length(ma_data_source *data_source, ma_uint64 *length)
+{
+    *length = ((PlayerMp3Source *)data_source)->length;
+    return MA_SUCCESS;
+}
+
+static ma_data_source_vtable player_mp3_vtable = {
+    player_mp3_read,
+    player_mp3_seek,
+    player_mp3_get_data_format,
+    player_mp3_get_cursor,
+    player_mp3_get_length,
+    NULL, // onSetLooping
+    0};
+
+/**
+ * Finish a backend object whose ma_mp3 is initialized
+ * key: File identity, or NULL if unknown (seeks stay brute force)
+ */
+static ma_result player_mp3_finish(PlayerContext *ctx, PlayerMp3Source *source, const PlayerSeekKey *key,
+                                   const ma_allocation_callbacks *allocation, ma_data_source **out)
+{
+    ma_data_source_config config = ma_data_source_config_init();
+    config.vtable = &player_mp3_vtable;
+
+    ma_result result = ma_data_source_init(&config, &source->base);
+    if (result != MA_SUCCESS)
+    {
+        ma_mp3_uninit(&source->mp3, allocation);
+        ma_free(source, allocation);
+        return result;
+    }
+
+    // Without a Xing/LAME header this walks every frame header. Streams
+    // asked for it once anyway; buffers were asked on every audio callback.
+    ma_mp3_get_length_in_pcm_frames(&source->mp3, &source->length);
+    source->ctx = ctx;
+    source->index = key ? player_seek_acquire(ctx, key) : NULL;
+    source->bound = 0;
+    *out = (ma_data_source *)source;
+    return MA_SUCCESS;
+}
+
+/**
+ * Backend entry for files read through callbacks (streams)
+ */
+static ma_result player_mp3_init(void *user_data, ma_read_proc on_read, ma_seek_proc on_seek, ma_tell_proc on_tell,
+                                 void *read_user_data, const ma_decoding_backend_config *config,
+                                 const ma_allocation_callbacks *allocation, ma_data_source **out)
+{
+    PlayerContext *ctx = (PlayerContext *)user_data;
+    PlayerBytes bytes;
+    PlayerSeekKey key;
+
+    if (player_bytes_init(&bytes, on_read, on_seek, on_tell, read_user_data) != 0 || !player_mp3_sniff(&bytes))
+        return MA_INVALID_FILE;
+
+    int known = player_seek_key(&bytes, &key) == 0;
+    if (on_seek(read_user_data, 0, ma_seek_origin_start) != MA_SUCCESS)
+        return MA_BAD_SEEK;
+
+    PlayerMp3Source *source = (PlayerMp3Source *)ma_malloc(sizeof(PlayerMp3Source), allocation);
+    if (!source)
+        return MA_OUT_OF_MEMORY;
+
+    ma_result result = ma_mp3_init(on_read, on_seek, on_tell, read_user_data, config, allocation, &source->mp3);
+    if (result != MA_SUCCESS)
+    {
+        ma_free(source, allocation);
+        return result;
+    }
+
+    return player_mp3_finish(ctx, source, known ? &key : NULL, allocation, out);
+}
+
+/**
+ * Backend entry for files the resource manager holds in memory
+ */
+static ma_result player_mp3_init_memory(void *user_data, const void *data, size_t size,
+                                        const ma_decoding_backend_config *config,
+                                        const ma_allocation_callbacks *allocation, ma_data_source **out)
+{
+    PlayerContext *ctx = (PlayerContext *)user_data;
+    PlayerMemoryReader reader = {(const ma_uint8 *)data, size, 0};
+    PlayerBytes bytes = {player_memory_read, player_memory_seek, &reader, size};
+    PlayerSeekKey key;
+
+    if (!player_mp3_sniff(&bytes))
+        return MA_INVALID_FILE;
+
+    int known = player_seek_key(&bytes, &key) == 0;
+
+    PlayerMp3Source *source = (PlayerMp3Source *)ma_malloc(sizeof(PlayerMp3Source), allocation);
+    if (!source)
+        return MA_OUT_OF_MEMORY;
+
+    ma_result result = ma_mp3_init_memory(data, size, config, allocation, &source->mp3);
+    if (result != MA_SUCCESS)
+    {
+        ma_free(source, allocation);
+        return result;
+    }
+
+    return player_mp3_finish(ctx, source, known ? &key : NULL, allocation, out);
+}
+
+static void player_mp3_uninit(void *user_data, ma_data_source *backend, const ma_allocation_callbacks *allocation)
+{
+    PlayerMp3Source *source = (PlayerMp3Source *)backend;
+    (void)user_data;
+
+    ma_mp3_uninit(&source->mp3, allocation);
+    ma_data_source_uninit(&source->base);
+    if (source->index)
+        player_seek_release(source->ctx, source->index);
+    ma_free(source, allocation);
+}
+
+static ma_decoding_backend_vtable player_mp3_backend = {
+    player_mp3_init,
+    NULL, // onInitFile
+    NULL, // onInitFileW
+    player_mp3_init_memory,
+    player_mp3_uninit};
+
+static ma_decoding_backend_vtable *player_decoding_backends[] = {&player_mp3_backend};
+
+/**
+ * Stop the seek index thread, abandoning a scan in progress
+ */
+static void player_seek_stop(PlayerContext *ctx)
+{
+    if (!ctx->seek_thread_started)
+        return;
+
+    pthread_mutex_lock(&ctx->seek_lock);
+    ma_atomic_store_32(&ctx->seek_quit, 1);
+    pthread_cond_signal(&ctx->seek_cond);
+    pthread_mutex_unlock(&ctx->seek_lock);
+    pthread_join(ctx->seek_thread, NULL);
+    ctx->seek_thread_started = 0;
+}
+
+/**
+ * Free every seek index entry and job (after the resource manager released
+ * all decoders)
+ */
+static void player_seek_shutdown(PlayerContext *ctx)
+{
+    while (ctx->seek_indexes)
+    {
+        PlayerSeekIndex *index = ctx->seek_indexes;
+        ctx->seek_indexes = index->next;
+        free(index->points);
+        free(index);
+    }
+
+    while (ctx->seek_jobs)
+    {
+        PlayerSeekJob *job = ctx->seek_jobs;
+        ctx->seek_jobs = job->next;
+        free(job->path);
+        free(job);
+    }
+
+    pthread_cond_destroy(&ctx->seek_cond);
+    pthread_mutex_destroy(&ctx->seek_lock);
+}
+
+/**
+ * Wake up the main loop (any thread)
+ */
+static void player_notify(PlayerContext *ctx)
+{
+    char byte = 1;
+    ssize_t written = write(ctx->event_pipe[1], &byte, 1);
+    (void)written; // A full pipe already has a wakeup pending
+}
+
+/**
+ * Sound end callback (audio thread): flag the sound and wake up the main loop
+ */
+static void player_on_sound_end(void *user_data, ma_sound *sound)
+{
+    PlayerContext *ctx = (PlayerContext *)user_data;
+    ma_atomic_exchange_ptr(&ctx->ended_sound, sound);
+    player_notify(ctx);
+}
+
+/**
+ * Drop a pending end flag for a sound that is being released, so a later
+ * sound allocated at the same address is not mistaken for it. Flags of
+ * other sounds are left alone.
+ */
+static void player_forget_end(PlayerContext *ctx, ma_sound *sound)
+{
+    void *expected = sound;
+    ma_atomic_compare_exchange_strong_ptr(&ctx->ended_sound, &expected, NULL);
+}
+
+/**
+ * Replace the current sound (UI thread). Once this returns the audio thread
+ * no longer reads the old one, so it may be freed.
+ */
+static void player_set_current(PlayerContext *ctx, ma_sound *sound)
+{
+    ma_spinlock_lock(&ctx->current_lock);
+    ctx->current = sound;
+    ctx->current_serial++;
+    ma_spinlock_unlock(&ctx->current_lock);
+}
+
+/**
+ * Publish a telemetry frame (audio thread)
+ */
+static void player_telemetry_publish(PlayerTelemetrySlot *slot, const PlayerTelemetryFrame *frame)
+{
+    ma_uint32 words[PLAYER_TELEMETRY_WORDS] = {0};
+    memcpy(words, frame, sizeof(*frame));
+
+    ma_uint32 sequence = ma_atomic_load_32(&slot->sequence);
+    ma_atomic_store_32(&slot->sequence, sequence + 1);
+    for (size_t i = 0; i < PLAYER_TELEMETRY_WORDS; i++)
+        ma_atomic_store_32(&slot->words[i], words[i]);
+    ma_atomic_store_32(&slot->sequence, sequence + 2);
+}
+
+/**
+ * Read the newest telemetry frame (any thread other than the audio thread)
+ */
+static void player_telemetry_read(PlayerTelemetrySlot *slot, PlayerTelemetryFrame *out)
+{
+    ma_uint32 words[PLAYER_TELEMETRY_WORDS];
+    ma_uint32 before;
+    ma_uint32 after;
+
+    // A write takes well under a microsecond, so this rarely loops
+    do
+    {
+        before = ma_atomic_load_32(&slot->sequence);
+        for (size_t i = 0; i < PLAYER_TELEMETRY_WORDS; i++)
+            words[i] = ma_atomic_load_32(&slot->words[i]);
+        after = ma_atomic_load_32(&slot->sequence);
+    } while ((before & 1) || before != after);
+
+    memcpy(out, words, sizeof(*out));
+}
+
+/**
+ * Mix a period, then measure it (audio thread, or the player_render() caller)
+ */
+static void player_mix(PlayerContext *ctx, float *output, ma_uint32 frame_count, ma_uint32 channels, ma_uint32 sample_rate)
+{
+    double start_ms = util_time_ms();
+    ma_engine_read_pcm_frames(&ctx->engine, output, frame_count, NULL);
+
+    PlayerTelemetry *totals = &ctx->telemetry_totals;
+    PlayerTelemetryFrame frame;
+    memset(&frame, 0, sizeof(frame));
+
+    // Output levels
+    ma_uint32 metered = channels < PLAYER_METER_CHANNELS ? channels : PLAYER_METER_CHANNELS;
+    const float *samples = output;
+    float sum[PLAYER_METER_CHANNELS] = {0};
+
+    for (ma_uint32 i = 0; i < frame_count; i++)
+    {
+        for (ma_uint32 c = 0; c < metered; c++)
+        {
+            float sample = samples[i * channels + c];
+            float level = sample < 0 ? -sample : sample;
+            if (level > frame.telemetry.peak[c])
+                frame.telemetry.peak[c] = level;
+            sum[c] += sample * sample;
+        }
+    }
+
+    frame.telemetry.channels = metered;
+    for (ma_uint32 c = 0; c < metered && frame_count > 0; c++)
+        frame.telemetry.rms[c] = sqrtf(sum[c] / frame_count);
+
+    // Keep the previous cursor if the UI is swapping tracks right now
+    if (ma_atomic_exchange_32(&ctx->current_lock, 1) == 0)
+    {
+        ma_sound *current = ctx->current;
+        ma_uint64 cursor = 0;
+        ma_uint64 length = 0;
+        ma_uint32 sample_rate = 0;
+
+        if (current &&
+            ma_sound_get_cursor_in_pcm_frames(current, &cursor) == MA_SUCCESS &&
+            ma_sound_get_data_format(current, NULL, NULL, &sample_rate, NULL, 0) == MA_SUCCESS)
+        {
+            ma_sound_get_length_in_pcm_frames(current, &length);
+            totals->cursor = cursor;
+            totals->length = length;
+            totals->sample_rate = sample_rate;
+        }
+        else
+        {
+            totals->cursor = 0;
+            totals->length = 0;
+            totals->sample_rate = 0;
+        }
+
+        ctx->telemetry_serial = ctx->current_serial;
+        ma_atomic_store_32(&ctx->current_lock, 0);
+    }
+
+    // Taking longer than the audio produced means the device ran dry
+    float callback_us = (float)((util_time_ms() - start_ms) * 1000.0);
+    float period_us = sample_rate > 0 ? frame_count * 1000000.0f / sample_rate : 0.0f;
+
+    totals->callbacks++;
+    if (callback_us > period_us)
+        totals->underruns++;
+    if (callback_us > totals->callback_max_us)
+        totals->callback_max_us = callback_us;
+
+    frame.telemetry.cursor = totals->cursor;
+    frame.telemetry.length = totals->length;
+    frame.telemetry.sample_rate = totals->sample_rate;
+    frame.telemetry.callback_us = callback_us;
+    frame.telemetry.callback_max_us = totals->callback_max_us;
+    frame.telemetry.period_us = period_us;
+    frame.telemetry.callbacks = totals->callbacks;
+    frame.telemetry.underruns = totals->underruns;
+    frame.serial = ctx->telemetry_serial;
+
+    player_telemetry_publish(&ctx->telemetry, &frame);
+}
+
+/**
+ * Output device callback (audio thread)
+ */
+static void player_data_callback(ma_device *device, void *output, const void *input, ma_uint32 frame_count)
+{
+    PlayerContext *ctx = (PlayerContext *)device->pUserData;
+    (void)input;
+
+    // The engine always mixes to f32
+    player_mix(ctx, (float *)output, frame_count, device->playback.channels, device->sampleRate);
+}
+
+/**
+ * Tap node callback (audio thread). Passthrough nodes get the mixed input
+ * already in place, so this only copies it out while enabled.
+ */
+static void player_tap_process(ma_node *node, const float **frames_in, ma_uint32 *frame_count_in,
+                               float **frames_out, ma_uint32 *frame_count_out)
+{
+    PlayerTapNode *tap = (PlayerTapNode *)node;
+    (void)frames_out;
+    (void)frame_count_out;
+
+    if (!ma_atomic_load_32(&tap->enabled))
+        return;
+
+    const float *input = frames_in[0];
+    ma_uint32 channels = ma_node_get_input_channels(node, 0);
+    ma_uint32 remaining = *frame_count_in;
+    float scale = 1.0f / channels;
+
+    while (remaining > 0)
+    {
+        ma_uint32 count = remaining;
+        void *region = NULL;
+        if (ma_pcm_rb_acquire_write(&tap->ring, &count, &region) != MA_SUCCESS || count == 0)
+        {
+            // The UI is behind; it only wants the newest samples anyway
+            ma_atomic_fetch_add_32(&tap->dropped, remaining);
+            return;
+        }
+
+        float *mono = (float *)region;
+        for (ma_uint32 i = 0; i < count; i++)
+        {
+            float sum = 0.0f;
+            for (ma_uint32 c = 0; c < channels; c++)
+                sum += input[i * channels + c];
+            mono[i] = sum * scale;
+        }
+
+        ma_pcm_rb_commit_write(&tap->ring, count);
+        input += count * channels;
+        remaining -= count;
+    }
+}
+
+static ma_node_vtable player_tap_vtable = {
+    player_tap_process,
+    NULL,
+    1, // Input buses
+    1, // Output buses
+    MA_NODE_FLAG_PASSTHROUGH};
+
+/**
+ * Create the tap node and put it in front of the engine endpoint
+ * Returns 0 on success, -1 on failure
+ */
+static int player_tap_init(PlayerContext *ctx)
+{
+    ma_uint32 channels = ma_engine_get_channels(&ctx->engine);
+    ma_node_config config = ma_node_config_init();
+    config.vtable = &player_tap_vtable;
+    config.pInputChannels = &channels;
+    config.pOutputChannels = &channels;
+
+    if (ma_pcm_rb_init(ma_format_f32, 1, PLAYER_TAP_FRAMES, NULL, NULL, &ctx->tap.ring) != MA_SUCCESS)
+        return -1;
+
+    if (ma_node_init(ma_engine_get_node_graph(&ctx->engine), &config, NULL, &ctx->tap) != MA_SUCCESS)
+    {
+        ma_pcm_rb_uninit(&ctx->tap.ring);
+        return -1;
+    }
+
+    ma_node_attach_output_bus(&ctx->tap, 0, ma_engine_get_endpoint(&ctx->engine), 0);
+    ctx->tap_initialized = 1;
+    return 0;
+}
+
+/**
+ * Remove the tap node; every sound must be uninitialized already
+ */
+static void player_tap_uninit(PlayerContext *ctx)
+{
+    if (!ctx->tap_initialized)
+        return;
+
+    ma_node_uninit(&ctx->tap, NULL);
+    ma_pcm_rb_uninit(&ctx->tap.ring);
+    ctx->tap_initialized = 0;
+}
+
+/**
+ * Create the non-blocking self-pipe used for audio thread notifications
+ * Returns 0 on success, -1 on failure
+ */
+static int player_event_pipe_open(PlayerContext *ctx)
+{
+    if (pipe(ctx->event_pipe) != 0)
+        return -1;
+
+    for (int i = 0; i < 2; i++)
+    {
+        int flags = fcntl(ctx->event_pipe[i], F_GETFL, 0);
+        fcntl(ctx->event_pipe[i], F_SETFL, flags | O_NONBLOCK);
+        fcntl(ctx->event_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    return 0;
+}
+
+/**
+ * Schedule the preloaded sound to start where the current one runs out.
+ * Audio thread only, with arm_lock held.
+ * Returns 0 once scheduled, -1 if the current length is not known yet.
+ */
+static int player_schedule_next(PlayerContext *ctx)
+{
+    ma_sound *current = ctx->current;
+    ma_sound *next = ctx->next;
+
+    ma_uint64 cursor = 0;
+    ma_uint64 length = 0;
+    ma_uint32 sample_rate = 0;
+
+    if (ma_sound_get_cursor_in_pcm_frames(current, &cursor) != MA_SUCCESS ||
+        ma_sound_get_length_in_pcm_frames(current, &length) != MA_SUCCESS ||
+        ma_sound_get_data_format(current, NULL, NULL, &sample_rate, NULL, 0) != MA_SUCCESS ||
+        length == 0 || sample_rate == 0)
+    {
+        return -1;
+    }
+
+    // Frames already pulled from the data source but not yet mixed are still
+    // ahead of us, on top of whatever the decoder has left.
+    ma_uint64 remaining = (length > cursor ? length - cursor : 0) + current->processingCacheFramesRemaining;
+    ma_uint64 engine_rate = ma_engine_get_sample_rate(&ctx->engine);
+    ma_uint64 remaining_frames = (remaining * engine_rate + sample_rate / 2) / sample_rate;
+
+    // Never overlap more than half of either track, or more than is left
+    ma_uint64 overlap = (ma_uint64)(ctx->crossfade_seconds * engine_rate);
+    ma_uint64 limit = (length * engine_rate / sample_rate) / 2;
+    if (overlap > limit)
+        overlap = limit;
+    if (overlap > remaining_frames)
+        overlap = remaining_frames;
+
+    ma_uint64 next_length = 0;
+    ma_uint32 next_rate = 0;
+    if (overlap > 0 &&
+        ma_sound_get_length_in_pcm_frames(next, &next_length) == MA_SUCCESS &&
+        ma_sound_get_data_format(next, NULL, NULL, &next_rate, NULL, 0) == MA_SUCCESS &&
+        next_length > 0 && next_rate > 0)
+    {
+        limit = (next_length * engine_rate / next_rate) / 2;
+        if (overlap > limit)
+            overlap = limit;
+    }
+
+    ma_uint64 start = ma_engine_get_time_in_pcm_frames(&ctx->engine) + remaining_frames - overlap;
+
+    if (overlap > 0)
+    {
+        // The fade-in starts with the sound's first processed frame
+        ma_sound_set_fade_in_pcm_frames(next, 0.0f, 1.0f, overlap);
+        ma_sound_set_fade_start_in_pcm_frames(current, 1.0f, 0.0f, overlap, start);
+    }
+
+    ma_sound_set_start_time_in_pcm_frames(next, start);
+    ma_sound_start(next);
+    return 0;
+}
+
+/**
+ * Engine process callback (audio thread), fired after every mixed period
+ */
+static void player_on_process(void *user_data, float *frames_out, ma_uint64 frame_count)
+{
+    PlayerContext *ctx = (PlayerContext *)user_data;
+    (void)frames_out;
+    (void)frame_count;
+
+    if (!ma_atomic_load_32(&ctx->arm_pending))
+        return;
+
+    // Never wait for the UI thread here; retry on the next period instead.
+    if (ma_atomic_exchange_32(&ctx->arm_lock, 1) != 0)
+        return;
+
+    if (ma_atomic_load_32(&ctx->arm_pending) && player_schedule_next(ctx) == 0)
+        ma_atomic_store_32(&ctx->arm_pending, 0);
+
+    ma_atomic_store_32(&ctx->arm_lock, 0);
+}
+
+/**
+ * Initialize the engine and the visualizer tap (loader thread)
+ * Returns 0 on success, -1 if there is no audio output
+ */
+static int player_engine_init(PlayerContext *ctx)
+{
+    // The device is started on first play, not while idling on the welcome screen
+    ma_engine_config engine_config = ma_engine_config_init();
+    engine_config.onProcess = player_on_process;
+    engine_config.pProcessUserData = ctx;
+    engine_config.noAutoStart = MA_TRUE;
+
+    // Offline players mix on request at a fixed format. Otherwise the device
+    // comes first: its rate is what tracks are decoded to.
+    ma_uint32 sample_rate = ctx->offline_rate;
+    if (ctx->offline)
+    {
+        engine_config.noDevice = MA_TRUE;
+        engine_config.channels = ctx->offline_channels;
+        engine_config.sampleRate = ctx->offline_rate;
+    }
+    else
+    {
+        // Set up as the engine would set up its own
+        ma_device_config device_config = ma_device_config_init(ma_device_type_playback);
+        device_config.playback.format = ma_format_f32;
+        device_config.dataCallback = player_data_callback;
+        device_config.pUserData = ctx;
+        device_config.noPreSilencedOutputBuffer = MA_TRUE; // The engine writes every frame
+        device_config.noClip = MA_TRUE;                    // and clips itself
+
+        if (ma_device_init(NULL, &device_config, &ctx->device) != MA_SUCCESS)
+            return -1;
+
+        sample_rate = ctx->device.sampleRate;
+        engine_config.pDevice = &ctx->device;
+    }
+
+    // Our own resource manager, set up like the engine's, so MP3s decode through the seek index backend
+    ma_resource_manager_config manager_config = ma_resource_manager_config_init();
+    manager_config.decodedFormat = ma_format_f32;
+    manager_config.decodedSampleRate = sample_rate;
+    if (ctx->seek_enabled)
+    {
+        manager_config.ppCustomDecodingBackendVTables = player_decoding_backends;
+        manager_config.customDecodingBackendCount = sizeof(player_decoding_backends) / sizeof(player_decoding_backends[0]);
+        manager_config.pCustomDecodingBackendUserData = ctx;
+    }
+
+    if (ma_resource_manager_init(&manager_config, &ctx->resource_manager) != MA_SUCCESS)
+    {
+        if (!ctx->offline)
+            ma_device_uninit(&ctx->device);
+        return -1;
+    }
+
+    engine_config.pResourceManager = &ctx->resource_manager;
+    if (ma_engine_init(&engine_config, &ctx->engine) != MA_SUCCESS)
+    {
+        ma_resource_manager_uninit(&ctx->resource_manager);
+        if (!ctx->offline)
+            ma_device_uninit(&ctx->device);
+        return -1;
+    }
+
+    // Without the tap sounds play straight into the endpoint; only the visualizer is lost
+    player_tap_init(ctx);
+    return 0;
+}
+
+/**
+ * Check whether the engine is usable (main thread)
+ * wait: 1 to block until the loader thread finished initializing it (and
+ *       report a failure), 0 to only look
+ * Returns 0 if ready, -1 if it failed or (without wait) is not ready yet
+ */
+static int player_engine_check(PlayerContext *ctx, int wait)
+{
+    if (ctx->engine_ready)
+        return 0;
+
+    pthread_mutex_lock(&ctx->load_lock);
+    while (wait && ctx->engine_state == PLAYER_ENGINE_STARTING)
+        pthread_cond_wait(&ctx->engine_cond, &ctx->load_lock);
+    PlayerEngineState state = ctx->engine_state;
+    pthread_mutex_unlock(&ctx->load_lock);
+
+    if (state == PLAYER_ENGINE_READY)
+    {
+        ctx->engine_ready = 1;
+        return 0;
+    }
+
+    if (wait && state == PLAYER_ENGINE_FAILED && !ctx->engine_reported)
+    {
+        error_print(ERR_PLAYER_INIT, "Failed to initialize audio engine");
+        ctx->engine_reported = 1;
+    }
+    return -1;
+}
+
+/**
+ * Initialize a sound from file, streaming it if it crosses the thresholds
+ * Returns MA_SUCCESS on success; out_stream receives the streaming decision
  */
+static ma_result player_load_sound(PlayerContext *ctx, const char *filepath, ma_uint32 flags, ma_sound *sound, int *out_stream)
+{
+    // Streams page in on the resource manager's thread, slower than an offline mix can pull them
+    int stream = !ctx->offline && player_should_stream(ctx, filepath);
+    if (stream)
+        flags |= MA_SOUND_FLAG_STREAM;
+    else
+        player_cache_lookup(ctx, filepath);
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
+    // Music is never pitched or placed in 3D; both stages cost time, and the
+    // pitch resampler delays the output by a frame
+    flags |= MA_SOUND_FLAG_NO_PITCH | MA_SOUND_FLAG_NO_SPATIALIZATION;
 
-#define MINIAUDIO_IMPLEMENTATION
-#include "miniaudio.h"
-#include "player.h"
-#include "error.h"
+    ma_result result = ma_sound_init_from_file(&ctx->engine, filepath, flags, NULL, NULL, sound);
+    if (result != MA_SUCCESS)
+        return result;
 
-// Internal miniaudio context (hidden from player.h)
-typedef struct
+    // Streams only ever hold a few pages, there is nothing worth keeping
+    if (!stream)
+        player_cache_keep(ctx, filepath);
+
+    // Nothing seeks during an offline render
+    if (ctx->seek_enabled && !ctx->offline)
+        player_seek_request(ctx, filepath);
+
+    ma_sound_set_end_callback(sound, player_on_sound_end, ctx);
+
+    // The lookup may stat the file, so it runs outside load_lock, which the
+    // UI thread takes on every poll. gain_calls keeps player_set_gain_lookup()
+    // from returning while the old hook is still in use here.
+    float gain = 1.0f;
+    pthread_mutex_lock(&ctx->load_lock);
+    PlayerGainLookup lookup = ctx->gain_lookup;
+    void *lookup_data = ctx->gain_user_data;
+    ctx->gain_calls += lookup != NULL;
+    pthread_mutex_unlock(&ctx->load_lock);
+
+    if (lookup)
+    {
+        lookup(lookup_data, filepath, &gain);
+
+        pthread_mutex_lock(&ctx->load_lock);
+        if (--ctx->gain_calls == 0)
+            pthread_cond_broadcast(&ctx->gain_cond);
+        pthread_mutex_unlock(&ctx->load_lock);
+    }
+    ma_sound_set_volume(sound, gain);
+
+    // Play through the visualizer tap instead of straight into the endpoint
+    if (ctx->tap_initialized)
+        ma_node_attach_output_bus(sound, 0, &ctx->tap, 0);
+
+    if (out_stream)
+        *out_stream = stream;
+
+    return MA_SUCCESS;
+}
+
+/**
+ * Stop, uninitialize and free a heap-allocated sound
+ */
+static void player_sound_free(ma_sound *sound)
 {
-    ma_engine engine;   // miniaudio engine instance
-    ma_sound sound;     // Currently loaded sound
-    int is_initialized; // 1 if engine initialized successfully
-} PlayerContext;
+    if (!sound)
+        return;
 
-Player *player_create(void)
+    ma_sound_stop(sound);
+    ma_sound_uninit(sound);
+    free(sound);
+}
+
+/**
+ * Release a sound that may have played (UI thread). Its end flag is dropped
+ * after it left the node graph, so no end callback can set it again, and
+ * before its memory can be handed to another sound.
+ */
+static void player_sound_release(PlayerContext *ctx, ma_sound *sound)
+{
+    if (!sound)
+        return;
+
+    ma_sound_stop(sound);
+    ma_sound_uninit(sound);
+    player_forget_end(ctx, sound);
+    free(sound);
+}
+
+static void player_job_free(PlayerLoadJob *job)
+{
+    if (!job)
+        return;
+
+    player_sound_free(job->sound);
+    free(job->path);
+    free(job);
+}
+
+/**
+ * Loader thread: takes the newest request, loads it and hands the result to
+ * the main loop unless a newer request arrived in the meantime.
+ */
+static void *player_loader_main(void *user_data)
+{
+    PlayerContext *ctx = (PlayerContext *)user_data;
+
+    PlayerEngineState state = player_engine_init(ctx) == 0 ? PLAYER_ENGINE_READY : PLAYER_ENGINE_FAILED;
+
+    pthread_mutex_lock(&ctx->load_lock);
+    ctx->engine_state = state;
+    pthread_cond_broadcast(&ctx->engine_cond);
+
+    for (;;)
+    {
+        while (!ctx->load_request && !ctx->loader_quit)
+            pthread_cond_wait(&ctx->load_cond, &ctx->load_lock);
+
+        if (ctx->loader_quit)
+            break;
+
+        PlayerLoadJob *job = ctx->load_request;
+        ctx->load_request = NULL;
+        pthread_mutex_unlock(&ctx->load_lock);
+
+        // File open and header parse happen here; decoding continues on the
+        // resource manager job threads.
+        ma_sound *sound = state == PLAYER_ENGINE_READY ? (ma_sound *)malloc(sizeof(ma_sound)) : NULL;
+        if (sound && player_load_sound(ctx, job->path, MA_SOUND_FLAG_ASYNC, sound, &job->stream) == MA_SUCCESS)
+            job->sound = sound;
+        else
+            free(sound);
+
+        PlayerLoadJob *discard = job;
+
+        pthread_mutex_lock(&ctx->load_lock);
+        if (job->generation == ctx->load_generation)
+        {
+            discard = ctx->load_done;
+            ctx->load_done = job;
+            player_notify(ctx);
+        }
+        pthread_mutex_unlock(&ctx->load_lock);
+
+        // Superseded while loading (or an uncollected older result)
+        player_job_free(discard);
+
+        pthread_mutex_lock(&ctx->load_lock);
+    }
+    pthread_mutex_unlock(&ctx->load_lock);
+
+    return NULL;
+}
+
+/**
+ * Hand a file to the loader thread, superseding any earlier request
+ * Returns 0 on success, -1 on allocation failure
+ */
+static int player_post_load(PlayerContext *ctx, const char *filepath, PlayerLoadKind kind)
+{
+    PlayerLoadJob *job = (PlayerLoadJob *)calloc(1, sizeof(PlayerLoadJob));
+    char *path = player_strdup(filepath);
+    char *file = player_strdup(filepath);
+    if (!job || !path || !file)
+    {
+        free(job);
+        free(path);
+        free(file);
+        return -1;
+    }
+    job->path = path;
+
+    pthread_mutex_lock(&ctx->load_lock);
+    job->generation = ++ctx->load_generation;
+    PlayerLoadJob *replaced = ctx->load_request;
+    PlayerLoadJob *stale = ctx->load_done;
+    ctx->load_request = job;
+    ctx->load_done = NULL;
+    pthread_cond_signal(&ctx->load_cond);
+    pthread_mutex_unlock(&ctx->load_lock);
+
+    player_job_free(replaced);
+    player_job_free(stale);
+
+    free(ctx->load_file);
+    ctx->load_file = file;
+    ctx->load_kind = kind;
+    ctx->load_pending = 1;
+    return 0;
+}
+
+/**
+ * Abandon the outstanding background load, if any
+ */
+static void player_cancel_load(PlayerContext *ctx)
+{
+    if (!ctx->load_pending)
+        return;
+
+    pthread_mutex_lock(&ctx->load_lock);
+    ctx->load_generation++;
+    PlayerLoadJob *replaced = ctx->load_request;
+    PlayerLoadJob *stale = ctx->load_done;
+    ctx->load_request = NULL;
+    ctx->load_done = NULL;
+    pthread_mutex_unlock(&ctx->load_lock);
+
+    player_job_free(replaced);
+    player_job_free(stale);
+
+    free(ctx->load_file);
+    ctx->load_file = NULL;
+    ctx->load_pending = 0;
+}
+
+/**
+ * Check if the current track is still being loaded in the background
+ */
+static int player_loading(const PlayerContext *ctx)
+{
+    return ctx->load_pending && ctx->load_kind == PLAYER_LOAD_PLAY;
+}
+
+/**
+ * Start the output device if it is not running
+ * Returns 0 on success, -1 on failure
+ */
+static int player_device_start(PlayerContext *ctx)
+{
+    if (ctx->device_running || ctx->offline)
+        return 0;
+
+    if (ma_engine_start(&ctx->engine) != MA_SUCCESS)
+        return -1;
+
+    ctx->device_running = 1;
+    return 0;
+}
+
+/**
+ * Stop the output device so the audio thread stops waking up
+ */
+static void player_device_stop(PlayerContext *ctx)
+{
+    if (!ctx->device_running)
+        return;
+
+    ma_engine_stop(&ctx->engine);
+    ctx->device_running = 0;
+}
+
+/**
+ * Enable or cancel scheduling of the preloaded sound (UI thread).
+ * Once this returns the audio thread is no longer touching the schedule.
+ */
+static void player_set_next_armed(PlayerContext *ctx, int armed)
+{
+    ma_spinlock_lock(&ctx->arm_lock);
+    ma_atomic_store_32(&ctx->arm_pending, armed ? 1 : 0);
+    ma_spinlock_unlock(&ctx->arm_lock);
+}
+
+/**
+ * Release the preloaded sound, if any
+ */
+static void player_drop_next(PlayerContext *ctx)
+{
+    if (!ctx->next)
+        return;
+
+    player_set_next_armed(ctx, 0);
+    player_sound_release(ctx, ctx->next);
+    ctx->next = NULL;
+
+    // Nothing follows any more, so the current track plays out at full volume
+    if (ctx->current)
+        ma_sound_reset_fade(ctx->current);
+
+    free(ctx->next_file);
+    ctx->next_file = NULL;
+    ctx->next_streaming = 0;
+}
+
+/**
+ * Release the current sound, if any
+ */
+static void player_unload_current(Player *player, PlayerContext *ctx)
+{
+    ma_sound *sound = ctx->current;
+    player_set_current(ctx, NULL);
+    player_sound_release(ctx, sound);
+    player->is_playing = 0;
+    player->is_paused = 0;
+}
+
+/**
+ * Unschedule a start (and crossfade) of the next sound that was already
+ * computed; it is redone from scratch when re-armed. Disarm first.
+ */
+static void player_unschedule_next(PlayerContext *ctx)
+{
+    ma_sound_stop(ctx->next);
+    ma_sound_reset_fade(ctx->next);
+    if (ctx->current)
+        ma_sound_reset_fade(ctx->current);
+
+    ma_uint64 cursor = 0;
+    if (ma_sound_get_cursor_in_pcm_frames(ctx->next, &cursor) == MA_SUCCESS && cursor > 0)
+        ma_sound_seek_to_pcm_frame(ctx->next, 0);
+}
+
+/**
+ * Arm the preloaded sound when it can follow the current one seamlessly
+ */
+static void player_update_next_schedule(Player *player, PlayerContext *ctx)
+{
+    if (!ctx->next)
+        return;
+
+    int can_chain = player->is_playing && !player->is_paused && !player->loop_enabled;
+    player_set_next_armed(ctx, can_chain);
+
+    if (!can_chain)
+        player_unschedule_next(ctx);
+}
+
+
+/**
+ * Start the freshly loaded current sound
+ * Returns 0 on success, -1 on failure (the sound is released)
+ */
+static int player_start_current(Player *player, PlayerContext *ctx, int stream)
+{
+    if (player_device_start(ctx) != 0)
+    {
+        error_print(ERR_PLAYBACK_START, "Failed to start audio device");
+        player_unload_current(player, ctx);
+        player->current_file = NULL;
+        return -1;
+    }
+
+    if (ma_sound_start(ctx->current) != MA_SUCCESS)
+    {
+        error_print(ERR_PLAYBACK_START, "Failed to start playback");
+        player_unload_current(player, ctx);
+        player->current_file = NULL;
+        return -1;
+    }
+
+    ma_sound_set_looping(ctx->current, player->loop_enabled);
+
+    player->is_playing = 1;
+    player->is_paused = 0;
+
+    ctx->is_streaming = stream;
+    ctx->stats.tracks_loaded++;
+    if (stream)
+        ctx->stats.tracks_streamed++;
+
+    return 0;
+}
+
+/**
+ * Make the preloaded sound the current one without reloading it.
+ * If its scheduled start has not been reached yet it starts right away.
+ */
+static void player_advance_to_next(Player *player, PlayerContext *ctx, const char *filepath)
+{
+    ma_sound *previous = ctx->current;
+
+    player_set_next_armed(ctx, 0);
+
+    // Skipping ahead of a crossfade starts the next track at full volume
+    ma_sound_set_start_time_in_pcm_frames(ctx->next, 0);
+    ma_sound_reset_fade(ctx->next);
+    ma_sound_start(ctx->next);
+    player_device_start(ctx);
+
+    player_set_current(ctx, ctx->next);
+    ctx->next = NULL;
+    player_sound_release(ctx, previous);
+
+    ctx->is_streaming = ctx->next_streaming;
+    ctx->next_streaming = 0;
+    free(ctx->next_file);
+    ctx->next_file = NULL;
+
+    ma_sound_set_looping(ctx->current, player->loop_enabled);
+
+    player->current_file = filepath;
+    player->is_paused = 0;
+
+    ctx->stats.tracks_loaded++;
+    ctx->stats.tracks_gapless++;
+    if (ctx->is_streaming)
+        ctx->stats.tracks_streamed++;
+}
+
+/**
+ * Create a player
+ * offline_rate, offline_channels: Output format without a device, or 0 to
+ *                                 play through the default device
+ */
+static Player *player_create_internal(ma_uint32 offline_rate, ma_uint32 offline_channels)
 {
     Player *player = (Player *)malloc(sizeof(Player));
     if (!player)
         return NULL;
 
-    PlayerContext *ctx = (PlayerContext *)malloc(sizeof(PlayerContext));
+    PlayerContext *ctx = (PlayerContext *)calloc(1, sizeof(PlayerContext));
     if (!ctx)
     {
         free(player);
         return NULL;
     }
 
-    ma_result result = ma_engine_init(NULL, &ctx->engine);
-    if (result != MA_SUCCESS)
+    ctx->offline = offline_rate > 0;
+    ctx->offline_rate = offline_rate;
+    ctx->offline_channels = offline_channels;
+
+    // The engine may start calling back as soon as it is initialized
+    ctx->arm_lock = 0;
+    ctx->arm_pending = 0;
+    ctx->current_lock = 0;
+
+    if (player_event_pipe_open(ctx) != 0)
     {
-        error_print(ERR_PLAYER_INIT, "Failed to initialize audio engine");
+        error_print(ERR_PLAYER_INIT, "Failed to create event pipe");
+        free(ctx);
+        free(player);
+        return NULL;
+    }
+
+    ctx->crossfade_seconds = config_get_double("crossfade_seconds", 0.0);
+    if (!(ctx->crossfade_seconds > 0.0))
+        ctx->crossfade_seconds = 0.0;
+    if (ctx->crossfade_seconds > PLAYER_CROSSFADE_MAX_SECONDS)
+        ctx->crossfade_seconds = PLAYER_CROSSFADE_MAX_SECONDS;
+
+    long cache_mb = config_get_long("cache_mb", PLAYER_CACHE_MB);
+    ctx->cache_budget = cache_mb > 0 ? (long long)cache_mb * 1024 * 1024 : 0;
+    pthread_mutex_init(&ctx->cache_lock, NULL);
+
+    // Without its thread no index is ever built; seeks stay brute force
+    ctx->seek_enabled = config_get_long("seek_index", 1) != 0;
+    pthread_mutex_init(&ctx->seek_lock, NULL);
+    pthread_cond_init(&ctx->seek_cond, NULL);
+    if (ctx->seek_enabled && pthread_create(&ctx->seek_thread, NULL, player_seek_main, ctx) == 0)
+        ctx->seek_thread_started = 1;
+
+    // The loader thread initializes the engine before it takes any request
+    ctx->engine_state = PLAYER_ENGINE_STARTING;
+    pthread_mutex_init(&ctx->load_lock, NULL);
+    pthread_cond_init(&ctx->load_cond, NULL);
+    pthread_cond_init(&ctx->engine_cond, NULL);
+    pthread_cond_init(&ctx->gain_cond, NULL);
+
+    if (pthread_create(&ctx->loader, NULL, player_loader_main, ctx) != 0)
+    {
+        error_print(ERR_PLAYER_INIT, "Failed to start loader thread");
+        player_seek_stop(ctx);
+        player_seek_shutdown(ctx);
+        pthread_cond_destroy(&ctx->engine_cond);
+        pthread_cond_destroy(&ctx->gain_cond);
+        pthread_cond_destroy(&ctx->load_cond);
+        pthread_mutex_destroy(&ctx->load_lock);
+        pthread_mutex_destroy(&ctx->cache_lock);
+        close(ctx->event_pipe[0]);
+        close(ctx->event_pipe[1]);
         free(ctx);
         free(player);
         return NULL;
@@ -52,46 +2171,176 @@ Player *player_create(void)
     player->audio_context = ctx;
     ctx->is_initialized = 1;
 
-    return player;
+    return player;
+}
+
+Player *player_create(void)
+{
+    return player_create_internal(0, 0);
+}
+
+Player *player_create_offline(unsigned int sample_rate, unsigned int channels)
+{
+    if (sample_rate == 0 || channels == 0)
+        return NULL;
+
+    return player_create_internal(sample_rate, channels);
+}
+
+int player_play(Player *player, const char *filepath)
+{
+    if (!player || !filepath)
+        return -1;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized)
+        return -1;
+
+    if (player->is_playing && ctx->next && strcmp(ctx->next_file, filepath) == 0)
+    {
+        player_advance_to_next(player, ctx, filepath);
+        return 0;
+    }
+
+    player_cancel_load(ctx);
+    player_drop_next(ctx);
+    player_unload_current(player, ctx);
+
+    if (player_engine_check(ctx, 1) != 0)
+    {
+        player->current_file = NULL;
+        return -1;
+    }
+
+    ma_sound *sound = (ma_sound *)malloc(sizeof(ma_sound));
+    int stream = 0;
+    if (!sound || player_load_sound(ctx, filepath, 0, sound, &stream) != MA_SUCCESS)
+    {
+        free(sound);
+        error_print(ERR_FILE_LOAD, filepath);
+        return -1;
+    }
+
+    player_set_current(ctx, sound);
+    player->current_file = filepath;
+
+    return player_start_current(player, ctx, stream);
+}
+
+int player_play_async(Player *player, const char *filepath)
+{
+    if (!player || !filepath)
+        return -1;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized)
+        return -1;
+
+    if (player->is_playing && ctx->next && strcmp(ctx->next_file, filepath) == 0)
+    {
+        player_advance_to_next(player, ctx, filepath);
+        return 0;
+    }
+
+    // A preload of this very file that is still in flight becomes the play request
+    int adopt = ctx->load_pending && ctx->load_kind == PLAYER_LOAD_PRELOAD &&
+                strcmp(ctx->load_file, filepath) == 0;
+
+    player_drop_next(ctx);
+    player_unload_current(player, ctx);
+
+    if (adopt)
+    {
+        ctx->load_kind = PLAYER_LOAD_PLAY;
+    }
+    else if (player_post_load(ctx, filepath, PLAYER_LOAD_PLAY) != 0)
+    {
+        error_print(ERR_FILE_LOAD, filepath);
+        player->current_file = NULL;
+        player_device_stop(ctx);
+        return -1;
+    }
+
+    // The track counts as playing from now on; position and pause wait for the load
+    player->current_file = filepath;
+    player->is_playing = 1;
+    player->is_paused = 0;
+    ctx->is_streaming = 0;
+
+    return 0;
 }
 
-int player_play(Player *player, const char *filepath)
+PlayerLoadResult player_poll_load(Player *player)
 {
-    if (!player || !filepath)
-        return -1;
+    if (!player)
+        return PLAYER_LOAD_NONE;
 
     PlayerContext *ctx = (PlayerContext *)player->audio_context;
-    if (!ctx || !ctx->is_initialized)
-        return -1;
+    if (!ctx || !ctx->is_initialized || !ctx->load_pending)
+        return PLAYER_LOAD_NONE;
 
-    if (player->is_playing)
-    {
-        ma_sound_stop(&ctx->sound);
-        ma_sound_uninit(&ctx->sound);
-    }
+    pthread_mutex_lock(&ctx->load_lock);
+    PlayerLoadJob *job = ctx->load_done;
+    ctx->load_done = NULL;
+    pthread_mutex_unlock(&ctx->load_lock);
 
-    ma_result result = ma_sound_init_from_file(&ctx->engine, filepath, 0, NULL, NULL, &ctx->sound);
-    if (result != MA_SUCCESS)
+    if (!job)
+        return PLAYER_LOAD_NONE;
+
+    PlayerLoadKind kind = ctx->load_kind;
+    ctx->load_pending = 0;
+    free(ctx->load_file);
+    ctx->load_file = NULL;
+
+    if (kind == PLAYER_LOAD_PRELOAD)
     {
-        error_print(ERR_FILE_LOAD, filepath);
-        return -1;
+        if (job->sound && player->is_playing && !ctx->next)
+        {
+            ctx->next = job->sound;
+            ctx->next_file = job->path;
+            ctx->next_streaming = job->stream;
+            job->sound = NULL;
+            job->path = NULL;
+            player_update_next_schedule(player, ctx);
+        }
+
+        player_job_free(job);
+        return PLAYER_LOAD_NONE;
     }
 
-    result = ma_sound_start(&ctx->sound);
-    if (result != MA_SUCCESS)
+    // The loader thread settled the engine before it took this job
+    if (!job->sound)
     {
-        error_print(ERR_PLAYBACK_START, "Failed to start playback");
-        ma_sound_uninit(&ctx->sound);
-        return -1;
+        if (player_engine_check(ctx, 1) == 0)
+            error_print(ERR_FILE_LOAD, job->path);
+        player_job_free(job);
+        player_unload_current(player, ctx);
+        player->current_file = NULL;
+        player_device_stop(ctx);
+        return PLAYER_LOAD_FAILED;
     }
 
-    ma_sound_set_looping(&ctx->sound, player->loop_enabled);
+    player_set_current(ctx, job->sound);
+    job->sound = NULL;
+    int stream = job->stream;
+    player_job_free(job);
 
-    player->current_file = filepath;
-    player->is_playing = 1;
-    player->is_paused = 0;
+    if (player_start_current(player, ctx, stream) != 0)
+        return PLAYER_LOAD_FAILED;
 
-    return 0;
+    return PLAYER_LOAD_STARTED;
+}
+
+int player_is_loading(Player *player)
+{
+    if (!player)
+        return 0;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized)
+        return 0;
+
+    return player_loading(ctx);
 }
 
 void player_pause(Player *player)
@@ -100,11 +2349,14 @@ void player_pause(Player *player)
         return;
 
     PlayerContext *ctx = (PlayerContext *)player->audio_context;
-    if (!ctx || !player->is_playing || player->is_paused)
+    if (!ctx || !ctx->current || player->is_paused)
         return;
 
-    ma_sound_set_volume(&ctx->sound, 0.0f);
+    // Stopping keeps the cursor where it is; nothing decodes until resume
+    ma_sound_stop(ctx->current);
     player->is_paused = 1;
+    player_update_next_schedule(player, ctx);
+    player_device_stop(ctx);
 }
 
 void player_resume(Player *player)
@@ -113,11 +2365,18 @@ void player_resume(Player *player)
         return;
 
     PlayerContext *ctx = (PlayerContext *)player->audio_context;
-    if (!ctx || !player->is_playing || !player->is_paused)
+    if (!ctx || !ctx->current || !player->is_paused)
+        return;
+
+    if (player_device_start(ctx) != 0)
+    {
+        error_print(ERR_PLAYBACK_START, "Failed to start audio device");
         return;
+    }
 
-    ma_sound_set_volume(&ctx->sound, 1.0f);
+    ma_sound_start(ctx->current);
     player->is_paused = 0;
+    player_update_next_schedule(player, ctx);
 }
 
 void player_stop(Player *player)
@@ -129,14 +2388,11 @@ void player_stop(Player *player)
     if (!ctx || !ctx->is_initialized)
         return;
 
-    if (player->is_playing)
-    {
-        ma_sound_stop(&ctx->sound);
-        ma_sound_uninit(&ctx->sound);
-    }
+    player_cancel_load(ctx);
+    player_drop_next(ctx);
+    player_unload_current(player, ctx);
+    player_device_stop(ctx);
 
-    player->is_playing = 0;
-    player->is_paused = 0;
     player->current_file = NULL;
 }
 
@@ -150,24 +2406,67 @@ void player_destroy(Player *player)
     PlayerContext *ctx = (PlayerContext *)player->audio_context;
     if (ctx && ctx->is_initialized)
     {
-        ma_engine_uninit(&ctx->engine);
+        // Lets a load in progress finish, then the thread exits
+        pthread_mutex_lock(&ctx->load_lock);
+        ctx->loader_quit = 1;
+        pthread_cond_signal(&ctx->load_cond);
+        pthread_mutex_unlock(&ctx->load_lock);
+        pthread_join(ctx->loader, NULL);
+        player_seek_stop(ctx);
+
+        player_job_free(ctx->load_request);
+        player_job_free(ctx->load_done);
+        pthread_cond_destroy(&ctx->engine_cond);
+        pthread_cond_destroy(&ctx->gain_cond);
+        pthread_cond_destroy(&ctx->load_cond);
+        pthread_mutex_destroy(&ctx->load_lock);
+
+        // The loader thread has exited, so engine_state is final
+        if (ctx->engine_state == PLAYER_ENGINE_READY)
+        {
+            player_cache_clear(ctx);
+            player_tap_uninit(ctx);
+            ma_engine_uninit(&ctx->engine);
+            if (!ctx->offline)
+                ma_device_uninit(&ctx->device);
+            ma_resource_manager_uninit(&ctx->resource_manager);
+        }
+        player_seek_shutdown(ctx);
+        pthread_mutex_destroy(&ctx->cache_lock);
+        close(ctx->event_pipe[0]);
+        close(ctx->event_pipe[1]);
         free(ctx);
     }
 
     free(player);
 }
 
+/**
+ * Get the audio thread's view of the current track (UI thread)
+ * Returns 1 if out describes the current track, 0 if it predates it
+ */
+static int player_current_telemetry(PlayerContext *ctx, PlayerTelemetryFrame *out)
+{
+    player_telemetry_read(&ctx->telemetry, out);
+    return out->serial == ctx->current_serial && out->telemetry.sample_rate > 0;
+}
+
 float player_get_position(Player *player)
 {
     if (!player || !player->is_playing)
         return 0.0f;
 
     PlayerContext *ctx = (PlayerContext *)player->audio_context;
-    if (!ctx || !ctx->is_initialized)
+    if (!ctx || !ctx->current)
         return 0.0f;
 
+    PlayerTelemetryFrame frame;
+    if (player_current_telemetry(ctx, &frame))
+        return (float)frame.telemetry.cursor / frame.telemetry.sample_rate;
+
+    // Nothing mixed since the track changed (or the device is stopped)
     float position = 0.0f;
-    ma_sound_get_cursor_in_seconds(&ctx->sound, &position);
+    ma_sound_get_cursor_in_seconds(ctx->current, &position);
     return position;
 }
 
@@ -177,24 +2476,79 @@ float player_get_duration(Player *player)
         return 0.0f;
 
     PlayerContext *ctx = (PlayerContext *)player->audio_context;
-    if (!ctx || !ctx->is_initialized)
+    if (!ctx || !ctx->current)
         return 0.0f;
 
+    PlayerTelemetryFrame frame;
+    if (player_current_telemetry(ctx, &frame) && frame.telemetry.length > 0)
+        return (float)frame.telemetry.length / frame.telemetry.sample_rate;
+
     float duration = 0.0f;
-    ma_sound_get_length_in_seconds(&ctx->sound, &duration);
+    ma_sound_get_length_in_seconds(ctx->current, &duration);
     return duration;
 }
 
+int player_seek(Player *player, float seconds)
+{
+    if (!player || !player->is_playing)
+        return -1;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->current)
+        return -1;
+
+    ma_uint32 sample_rate = 0;
+    if (ma_sound_get_data_format(ctx->current, NULL, NULL, &sample_rate, NULL, 0) != MA_SUCCESS || sample_rate == 0)
+        return -1;
+
+    // The duration the audio thread published; asking the decoder may mean a walk over the file
+    float duration = player_get_duration(player);
+    if (duration > 0.0f && seconds > duration)
+        seconds = duration;
+    ma_uint64 frame = seconds > 0.0f ? (ma_uint64)((double)seconds * sample_rate) : 0;
+
+    // The next track's start was computed from the old position
+    if (ctx->next)
+    {
+        player_set_next_armed(ctx, 0);
+        player_unschedule_next(ctx);
+    }
+
+    if (ma_sound_seek_to_pcm_frame(ctx->current, frame) != MA_SUCCESS)
+    {
+        player_update_next_schedule(player, ctx);
+        return -1;
+    }
+
+    // Telemetry mixed before the seek no longer describes the current sound
+    player_set_current(ctx, ctx->current);
+    player_update_next_schedule(player, ctx);
+    return 0;
+}
+
 int player_has_finished(Player *player)
 {
     if (!player || !player->is_playing)
         return 0;
 
     PlayerContext *ctx = (PlayerContext *)player->audio_context;
-    if (!ctx || !ctx->is_initialized)
+    if (!ctx || !ctx->current)
+        return 0;
+
+    return ma_sound_at_end(ctx->current);
+}
+
+int player_take_track_end(Player *player)
+{
+    if (!player)
+        return 0;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx)
         return 0;
 
-    return ma_sound_at_end(&ctx->sound);
+    ma_sound *ended = (ma_sound *)ma_atomic_exchange_ptr(&ctx->ended_sound, NULL);
+    return ended != NULL && ended == ctx->current && player->is_playing;
 }
 
 PlayerState player_get_state(Player *player)
@@ -205,6 +2559,9 @@ PlayerState player_get_state(Player *player)
     if (!player->is_playing)
         return STATE_STOPPED;
 
+    if (player_is_loading(player))
+        return STATE_LOADING;
+
     if (player->is_paused)
         return STATE_PAUSED;
 
@@ -229,7 +2586,9 @@ void player_toggle_loop(Player *player)
         return;
 
     player->loop_enabled = !player->loop_enabled;
-    ma_sound_set_looping(&ctx->sound, player->loop_enabled);
+    if (ctx->current)
+        ma_sound_set_looping(ctx->current, player->loop_enabled);
+    player_update_next_schedule(player, ctx);
 }
 
 int player_get_loop(Player *player)
@@ -251,8 +2610,294 @@ void player_set_loop(Player *player, int enabled)
 
     player->loop_enabled = enabled ? 1 : 0;
 
-    if (player->is_playing)
+    if (ctx->current)
+    {
+        ma_sound_set_looping(ctx->current, player->loop_enabled);
+        player_update_next_schedule(player, ctx);
+    }
+}
+
+int player_is_streaming(Player *player)
+{
+    if (!player || !player->is_playing)
+        return 0;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized)
+        return 0;
+
+    return ctx->is_streaming;
+}
+
+void player_get_stats(Player *player, PlayerStats *out)
+{
+    if (!out)
+        return;
+
+    memset(out, 0, sizeof(*out));
+
+    if (!player)
+        return;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized)
+        return;
+
+    *out = ctx->stats;
+
+    pthread_mutex_lock(&ctx->cache_lock);
+    out->cache_hits = ctx->cache_hits;
+    out->cache_misses = ctx->cache_misses;
+    out->cache_tracks = ctx->cache_count;
+    out->cache_bytes = (unsigned long long)ctx->cache_bytes;
+    pthread_mutex_unlock(&ctx->cache_lock);
+
+    pthread_mutex_lock(&ctx->seek_lock);
+    out->seek_indexes_built = ctx->seek_built;
+    out->seek_indexes_loaded = ctx->seek_loaded;
+    pthread_mutex_unlock(&ctx->seek_lock);
+}
+
+int player_preload_next(Player *player, const char *filepath)
+{
+    if (!player || !filepath)
+        return -1;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized || !ctx->current)
+        return -1;
+
+    if (ctx->next && strcmp(ctx->next_file, filepath) == 0)
+    {
+        player_update_next_schedule(player, ctx);
+        return 0;
+    }
+
+    // Already on its way
+    if (ctx->load_pending && strcmp(ctx->load_file, filepath) == 0)
+        return 0;
+
+    player_drop_next(ctx);
+
+    // Loaded in the background so preloading never stalls the UI or the current track
+    return player_post_load(ctx, filepath, PLAYER_LOAD_PRELOAD);
+}
+
+void player_cancel_preload(Player *player)
+{
+    if (!player)
+        return;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized)
+        return;
+
+    if (ctx->load_pending && ctx->load_kind == PLAYER_LOAD_PRELOAD)
+        player_cancel_load(ctx);
+
+    player_drop_next(ctx);
+}
+
+int player_get_event_fd(Player *player)
+{
+    if (!player)
+        return -1;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized)
+        return -1;
+
+    return ctx->event_pipe[0];
+}
+
+void player_drain_events(Player *player)
+{
+    int fd = player_get_event_fd(player);
+    if (fd < 0)
+        return;
+
+    char buf[64];
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+}
+
+void player_get_telemetry(Player *player, PlayerTelemetry *out)
+{
+    if (!out)
+        return;
+
+    memset(out, 0, sizeof(*out));
+
+    if (!player)
+        return;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized)
+        return;
+
+    PlayerTelemetryFrame frame;
+    player_telemetry_read(&ctx->telemetry, &frame);
+    *out = frame.telemetry;
+}
+
+int player_render(Player *player, float *out, unsigned int frame_count)
+{
+    if (!player || !out)
+        return -1;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized || !ctx->offline || player_engine_check(ctx, 1) != 0)
+        return -1;
+
+    // Mixing on would turn load time into silence (or a missed gapless start)
+    if (ctx->load_pending)
+        return 0;
+
+    // Blocks end with the current track, so a render can stop on its last frame.
+    // This is the mixing thread, so the sound may be queried directly.
+    ma_uint32 frames = frame_count;
+    ma_uint64 cursor = 0;
+    ma_uint64 length = 0;
+    ma_uint32 sample_rate = 0;
+    if (ctx->current && !player->loop_enabled &&
+        ma_sound_get_cursor_in_pcm_frames(ctx->current, &cursor) == MA_SUCCESS &&
+        ma_sound_get_length_in_pcm_frames(ctx->current, &length) == MA_SUCCESS &&
+        ma_sound_get_data_format(ctx->current, NULL, NULL, &sample_rate, NULL, 0) == MA_SUCCESS &&
+        sample_rate == ctx->offline_rate && length > 0)
+    {
+        ma_uint64 remaining = length > cursor ? length - cursor : 0;
+
+        // Only silence is left; mixing it lets the end be reported
+        if (remaining == 0 && !ctx->next)
+        {
+            player_mix(ctx, out, frame_count, ctx->offline_channels, ctx->offline_rate);
+            return 0;
+        }
+
+        if (remaining > 0 && remaining < frames)
+            frames = (ma_uint32)remaining;
+    }
+
+    player_mix(ctx, out, frames, ctx->offline_channels, ctx->offline_rate);
+    return (int)frames;
+}
+
+void player_set_visual_tap(Player *player, int enabled)
+{
+    if (!player)
+        return;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized || player_engine_check(ctx, 0) != 0 || !ctx->tap_initialized)
+        return;
+
+    ma_atomic_store_32(&ctx->tap.enabled, enabled ? 1 : 0);
+}
+
+size_t player_read_visual_samples(Player *player, float *out, size_t max_frames)
+{
+    if (!player || !out || max_frames == 0)
+        return 0;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized || player_engine_check(ctx, 0) != 0 || !ctx->tap_initialized)
+        return 0;
+
+    ma_pcm_rb *ring = &ctx->tap.ring;
+
+    // Only the newest max_frames matter; skip anything older
+    ma_uint32 available = ma_pcm_rb_available_read(ring);
+    if (available > max_frames)
+    {
+        ma_pcm_rb_seek_read(ring, available - (ma_uint32)max_frames);
+        available = (ma_uint32)max_frames;
+    }
+
+    size_t total = 0;
+    while (total < available)
     {
-        ma_sound_set_looping(&ctx->sound, player->loop_enabled);
+        ma_uint32 count = available - (ma_uint32)total;
+        void *region = NULL;
+        if (ma_pcm_rb_acquire_read(ring, &count, &region) != MA_SUCCESS || count == 0)
+            break;
+
+        memcpy(out + total, region, count * sizeof(float));
+        ma_pcm_rb_commit_read(ring, count);
+        total += count;
     }
+
+    return total;
+}
+
+unsigned int player_get_output_rate(Player *player)
+{
+    if (!player)
+        return 0;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized || player_engine_check(ctx, 0) != 0)
+        return 0;
+
+    return ma_engine_get_sample_rate(&ctx->engine);
+}
+
+int player_wait_ready(Player *player)
+{
+    if (!player)
+        return -1;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized)
+        return -1;
+
+    return player_engine_check(ctx, 1);
+}
+
+void player_set_gain_lookup(Player *player, PlayerGainLookup lookup, void *user_data)
+{
+    if (!player)
+        return;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized)
+        return;
+
+    // Once this returns no lookup through the old hook is still running
+    pthread_mutex_lock(&ctx->load_lock);
+    ctx->gain_lookup = lookup;
+    ctx->gain_user_data = user_data;
+    while (ctx->gain_calls > 0)
+        pthread_cond_wait(&ctx->gain_cond, &ctx->load_lock);
+    pthread_mutex_unlock(&ctx->load_lock);
+}
+
+void player_refresh_gain(Player *player)
+{
+    if (!player)
+        return;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized || !ctx->gain_lookup || !ctx->next)
+        return;
+
+    // Changing the level of a track that is already audible would be heard
+    ma_uint64 cursor = 0;
+    if (ma_sound_get_cursor_in_pcm_frames(ctx->next, &cursor) == MA_SUCCESS && cursor > 0)
+        return;
+
+    float gain = 1.0f;
+    ctx->gain_lookup(ctx->gain_user_data, ctx->next_file, &gain);
+    ma_sound_set_volume(ctx->next, gain);
+}
+
+void player_wake(Player *player)
+{
+    if (!player)
+        return;
+
+    PlayerContext *ctx = (PlayerContext *)player->audio_context;
+    if (!ctx || !ctx->is_initialized)
+        return;
+
+    player_notify(ctx);
 }
@@ -13,14 +13,66 @@
 #ifndef WALCMAN_PLAYER_H
 #define WALCMAN_PLAYER_H
 
+#include <stddef.h>
+
 // Playback state enum
 typedef enum
 {
     STATE_STOPPED, // No audio playing
     STATE_PLAYING, // Audio actively playing
-    STATE_PAUSED   // Playback paused
+    STATE_PAUSED,  // Playback paused
+    STATE_LOADING  // Track is being loaded in the background
 } PlayerState;
 
+// Outcome of a background load, see player_poll_load()
+typedef enum
+{
+    PLAYER_LOAD_NONE,    // Nothing finished (or only a preload)
+    PLAYER_LOAD_STARTED, // Requested track is loaded and playing
+    PLAYER_LOAD_FAILED   // Requested track could not be loaded; player is stopped
+} PlayerLoadResult;
+
+// Cumulative playback counters
+typedef struct PlayerStats
+{
+    unsigned long tracks_loaded;   // Tracks successfully loaded
+    unsigned long tracks_streamed; // Tracks loaded in streaming mode
+    unsigned long tracks_gapless;  // Tracks started from a preloaded sound
+    unsigned long cache_hits;      // Loads whose file was still in the track cache
+    unsigned long cache_misses;    // Cacheable loads that read the file
+    size_t cache_tracks;           // Tracks held by the cache now
+    unsigned long long cache_bytes; // Memory held by the cache now
+    unsigned long seek_indexes_built;  // MP3 seek indexes built by scanning the file
+    unsigned long seek_indexes_loaded; // MP3 seek indexes read back from disk
+} PlayerStats;
+
+#define PLAYER_METER_CHANNELS 2 // Output channels metered in PlayerTelemetry
+
+// Snapshot published by the audio thread after every device callback
+typedef struct PlayerTelemetry
+{
+    unsigned long long cursor;          // Current track position in its own PCM frames
+    unsigned long long length;          // Current track length in frames, 0 if unknown
+    unsigned int sample_rate;           // Current track sample rate, 0 if nothing is loaded
+    unsigned int channels;              // Entries used in peak/rms
+    float peak[PLAYER_METER_CHANNELS];  // Output peak of the last period (1.0 = full scale)
+    float rms[PLAYER_METER_CHANNELS];   // Output RMS of the last period
+    float callback_us;                  // Time spent in the last callback
+    float callback_max_us;              // Longest callback so far
+    float period_us;                    // Audio produced by the last callback
+    unsigned long long callbacks;       // Device callbacks so far
+    unsigned long long underruns;       // Callbacks that took longer than period_us
+} PlayerTelemetry;
+
+/**
+ * Source of per-track gain (called from the loader and main thread)
+ * user_data: Value given to player_set_gain_lookup()
+ * filepath: Track about to be played
+ * gain: Receives the linear gain; left at 1.0 if unknown
+ * Returns: 1 if the gain is known, 0 otherwise
+ */
+typedef int (*PlayerGainLookup)(void *user_data, const char *filepath, float *gain);
+
 // Audio player instance
 typedef struct Player
 {
@@ -33,10 +85,32 @@ typedef struct Player
 
 /**
  * Create a new audio player instance
+ * Returns right away; the audio engine and output device are initialized
+ * on a background thread (see player_wait_ready()).
  * Returns: Player pointer on success, NULL on failure
  */
 Player *player_create(void);
 
+/**
+ * Create a player without an output device. Nothing is heard; the caller
+ * pulls the mix with player_render(), as fast as the decoders allow.
+ * Everything else (loading, gapless starts, crossfades, events) behaves as
+ * with a device, except that files are never streamed.
+ * sample_rate: Output sample rate
+ * channels: Output channels
+ * Returns: Player pointer on success, NULL on failure
+ */
+Player *player_create_offline(unsigned int sample_rate, unsigned int channels);
+
+/**
+ * Wait until the audio engine is initialized
+ * Calls that need it wait on their own; this is for callers that want the
+ * device up front, e.g. to time it.
+ * player: Player instance
+ * Returns: 0 if the engine is ready, -1 if it could not be initialized
+ */
+int player_wait_ready(Player *player);
+
 /**
  * Load and play an audio file
  * player: Player instance
@@ -45,8 +119,35 @@ Player *player_create(void);
  */
 int player_play(Player *player, const char *filepath);
 
+/**
+ * Load and play an audio file without blocking the caller.
+ * The current track stops right away and the file is opened on a background
+ * thread; the event descriptor becomes readable when it is done and
+ * player_poll_load() starts it. A newer request or player_stop() cancels a
+ * load that has not finished yet. A preloaded track starts immediately.
+ * player: Player instance
+ * filepath: Path to audio file (must stay valid while it is current)
+ * Returns: 0 if playback started or the load was queued, -1 on failure
+ */
+int player_play_async(Player *player, const char *filepath);
+
+/**
+ * Finish a background load after the event descriptor became readable
+ * player: Player instance
+ * Returns: PlayerLoadResult describing what happened
+ */
+PlayerLoadResult player_poll_load(Player *player);
+
+/**
+ * Check if the current track is still being loaded
+ * player: Player instance
+ * Returns: 1 if loading, 0 otherwise
+ */
+int player_is_loading(Player *player);
+
 /**
  * Pause playback (can be resumed)
+ * Decoding stops and the output device is halted; the position is kept.
  * player: Player instance
  */
 void player_pause(Player *player);
@@ -83,6 +184,16 @@ float player_get_position(Player *player);
  */
 float player_get_duration(Player *player);
 
+/**
+ * Jump to a position in the current audio. MP3s seek through a seek index
+ * built in the background once the file is loaded; until it is ready they
+ * decode their way to the target.
+ * player: Player instance
+ * seconds: Target position, clamped to the track
+ * Returns: 0 on success, -1 if nothing is playing or the seek failed
+ */
+int player_seek(Player *player, float seconds);
+
 /**
  * Check if current audio has finished playing
  * player: Player instance
@@ -90,6 +201,16 @@ float player_get_duration(Player *player);
  */
 int player_has_finished(Player *player);
 
+/**
+ * Consume the end-of-track notification raised by the audio thread.
+ * The sound end callback records which sound ended in a lock-free flag
+ * and wakes the event descriptor; this reads and clears the flag, so each
+ * end is reported once and only for the track that is current.
+ * player: Player instance
+ * Returns: 1 if the current track ended since the last call, 0 otherwise
+ */
+int player_take_track_end(Player *player);
+
 /**
  * Get current playback state
  * player: Player instance
@@ -124,4 +245,126 @@ int player_get_loop(Player *player);
  */
 void player_set_loop(Player *player, int enabled);
 
+/**
+ * Preload the track expected to play after the current one.
+ * The preloaded track is scheduled to start on the exact frame the current
+ * track ends, and a following player_play() with the same path reuses it.
+ * The file is loaded in the background; a preload is dropped by any later
+ * play request for a different file.
+ * player: Player instance (must be playing)
+ * filepath: Path to audio file
+ * Returns: 0 if preloaded or queued for loading, -1 on failure
+ */
+int player_preload_next(Player *player, const char *filepath);
+
+/**
+ * Drop any preloaded next track
+ * player: Player instance
+ */
+void player_cancel_preload(Player *player);
+
+/**
+ * Get a file descriptor that becomes readable when the audio thread has
+ * something to report: a track reached its end or a background load finished.
+ * Use with poll()/select(), then call player_drain_events().
+ * player: Player instance
+ * Returns: Readable file descriptor, or -1 if unavailable
+ */
+int player_get_event_fd(Player *player);
+
+/**
+ * Consume pending notifications on the event descriptor
+ * player: Player instance
+ */
+void player_drain_events(Player *player);
+
+/**
+ * Check if current audio is streamed from disk instead of fully loaded.
+ * Files at least stream_threshold_mb large (default 16) are streamed, as are
+ * files longer than stream_threshold_minutes when that setting is present.
+ * player: Player instance
+ * Returns: 1 if streaming, 0 otherwise
+ */
+int player_is_streaming(Player *player);
+
+/**
+ * Get cumulative playback counters
+ * player: Player instance
+ * out: Receives the counters (zeroed if player is NULL)
+ */
+void player_get_stats(Player *player, PlayerStats *out);
+
+/**
+ * Get the newest audio thread telemetry without locking.
+ * Values are from the last device callback, so they stop changing while
+ * the device is stopped (paused or idle).
+ * player: Player instance
+ * out: Receives the snapshot (zeroed if player is NULL)
+ */
+void player_get_telemetry(Player *player, PlayerTelemetry *out);
+
+/**
+ * Mix the next frames of an offline player (see player_create_offline()).
+ * A block never runs past the end of the current track.
+ * player: Offline player instance
+ * out: Receives up to frame_count interleaved f32 frames
+ * frame_count: Frames to mix at most
+ * Returns: Frames mixed, fewer than frame_count if the current track ends
+ *          inside the block; 0 if there is nothing to write yet (a load is
+ *          pending, or the track's end is about to be reported on the event
+ *          descriptor); -1 on failure
+ */
+int player_render(Player *player, float *out, unsigned int frame_count);
+
+/**
+ * Start or stop copying the output into the visualizer ring.
+ * Leave it off while nothing reads the samples.
+ * player: Player instance
+ * enabled: 1 to copy, 0 to stop
+ */
+void player_set_visual_tap(Player *player, int enabled);
+
+/**
+ * Take the newest output samples (mono, output rate) from the visualizer
+ * ring; older samples that do not fit are discarded. Never blocks the
+ * audio thread.
+ * player: Player instance
+ * out: Receives up to max_frames samples, oldest first
+ * max_frames: Capacity of out
+ * Returns: Number of samples written
+ */
+size_t player_read_visual_samples(Player *player, float *out, size_t max_frames);
+
+/**
+ * Get the output device sample rate
+ * player: Player instance
+ * Returns: Sample rate in Hz, or 0 if unavailable
+ */
+unsigned int player_get_output_rate(Player *player);
+
+/**
+ * Set the gain applied to every track when it is loaded.
+ * Set it before the first track plays; the lookup must be thread-safe and
+ * must not call back into the player. Once this returns, no lookup through
+ * the previous hook is still running, so its user_data may be freed.
+ * player: Player instance
+ * lookup: Gain source, or NULL for unity gain
+ * user_data: Passed to lookup
+ */
+void player_set_gain_lookup(Player *player, PlayerGainLookup lookup, void *user_data);
+
+/**
+ * Ask the gain source again for the preloaded next track, as long as it has
+ * not started playing. Call after the source learned new gains.
+ * player: Player instance
+ */
+void player_refresh_gain(Player *player);
+
+/**
+ * Make the event descriptor readable (any thread), so the main loop runs
+ * player_refresh_gain() and other deferred work
+ * player: Player instance
+ */
+void player_wake(Player *player);
+
 #endif // WALCMAN_PLAYER_H
@@ -1,39 +1,91 @@
 /**
  * queue.c - Playlist and queue state management implementation
+ *
+ * Item paths live in a chunked string arena owned by the queue. Enqueueing
+ * copies a path into the current chunk, so it only allocates when a chunk
+ * fills up. Clearing rewinds the arena to its first chunk and keeps every
+ * chunk for reuse, so clearing costs the same for 10 or 100k items.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <strings.h>
 #include <time.h>
-#include <dirent.h>
-#include <sys/stat.h>
-#include <limits.h>
+#include <unistd.h>
 #include "queue.h"
 
-#ifndef PATH_MAX
-#define PATH_MAX 4096
-#endif
-
 #define QUEUE_INITIAL_CAPACITY 16
+#define QUEUE_HISTORY_DEFAULT_DEPTH 1000
+#define QUEUE_ARENA_CHUNK_SIZE (64 * 1024) // Bytes of path text per chunk
 
-static int queue_rng_seeded = 0;
+// Block of path storage; chunks form a list that is reused after a clear
+struct QueueArenaChunk
+{
+    QueueArenaChunk *next;
+    size_t size; // Bytes available in data
+    size_t used; // Bytes handed out since the last rewind
+    char data[];
+};
 
-static char *queue_strdup(const char *src)
+/**
+ * Copy a string into the queue's arena
+ * Returns: Copy that stays valid until the queue is cleared, or NULL
+ */
+static char *queue_arena_strdup(Queue *queue, const char *src)
 {
     if (!src)
         return NULL;
 
-    size_t len = strlen(src);
-    char *copy = (char *)malloc(len + 1);
-    if (!copy)
-        return NULL;
+    size_t len = strlen(src) + 1;
+    QueueArenaChunk *chunk = queue->arena_current;
+
+    if (!chunk || chunk->size - chunk->used < len)
+    {
+        // Move on to the next kept chunk if it is big enough, otherwise
+        // splice a new one in after the current chunk
+        QueueArenaChunk *next = chunk ? chunk->next : queue->arena_head;
+        if (next && next->size >= len)
+        {
+            chunk = next;
+        }
+        else
+        {
+            size_t size = len > QUEUE_ARENA_CHUNK_SIZE ? len : QUEUE_ARENA_CHUNK_SIZE;
+            QueueArenaChunk *fresh = (QueueArenaChunk *)malloc(sizeof(QueueArenaChunk) + size);
+            if (!fresh)
+                return NULL;
+
+            fresh->size = size;
+            fresh->next = next;
+            if (chunk)
+                chunk->next = fresh;
+            else
+                queue->arena_head = fresh;
+            chunk = fresh;
+        }
 
-    memcpy(copy, src, len + 1);
+        chunk->used = 0;
+        queue->arena_current = chunk;
+    }
+
+    char *copy = chunk->data + chunk->used;
+    memcpy(copy, src, len);
+    chunk->used += len;
     return copy;
 }
 
+/**
+ * Forget all arena strings; chunks stay allocated for the next load
+ */
+static void queue_arena_rewind(Queue *queue)
+{
+    queue->arena_current = queue->arena_head;
+    if (queue->arena_head)
+        queue->arena_head->used = 0;
+}
+
 static int queue_ensure_capacity(Queue *queue, size_t needed)
 {
     if (!queue)
@@ -55,57 +107,134 @@ static int queue_ensure_capacity(Queue *queue, size_t needed)
     return 0;
 }
 
-static void queue_seed_rng_once(void)
+/**
+ * xorshift64*: fast, and the same sequence for a given seed on every platform
+ */
+static uint64_t queue_random(Queue *queue)
 {
-    if (!queue_rng_seeded)
-    {
-        srand((unsigned int)time(NULL));
-        queue_rng_seeded = 1;
-    }
+    uint64_t x = queue->rng_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    queue->rng_state = x;
+    return x * 0x2545F4914F6CDD1DULL;
 }
 
-static int queue_ensure_visited_capacity(Queue *queue, size_t needed)
+static size_t queue_random_below(Queue *queue, size_t bound)
 {
-    if (!queue)
+    return (size_t)(queue_random(queue) % bound);
+}
+
+static int queue_order_reserve(Queue *queue, size_t needed)
+{
+    if (needed <= queue->order_capacity)
+        return 0;
+
+    size_t new_capacity = queue->order_capacity > 0 ? queue->order_capacity : QUEUE_INITIAL_CAPACITY;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+
+    size_t *new_order = (size_t *)realloc(queue->order, new_capacity * sizeof(size_t));
+    if (!new_order)
         return -1;
+    queue->order = new_order;
 
-    if (needed == 0)
+    size_t *new_pos = (size_t *)realloc(queue->order_pos, new_capacity * sizeof(size_t));
+    if (!new_pos)
+        return -1;
+    queue->order_pos = new_pos;
+
+    queue->order_capacity = new_capacity;
+    return 0;
+}
+
+static void queue_order_swap(Queue *queue, size_t a, size_t b)
+{
+    size_t item_a = queue->order[a];
+    size_t item_b = queue->order[b];
+
+    queue->order[a] = item_b;
+    queue->order[b] = item_a;
+    queue->order_pos[item_b] = a;
+    queue->order_pos[item_a] = b;
+}
+
+/**
+ * Start a new shuffle cycle with a fresh Fisher-Yates permutation.
+ * first: Item placed at the front and counted as played, or -1
+ */
+static int queue_shuffle_build(Queue *queue, int first)
+{
+    if (queue_order_reserve(queue, queue->count) != 0)
+        return -1;
+
+    for (size_t i = 0; i < queue->count; i++)
     {
-        free(queue->visited);
-        queue->visited = NULL;
-        return 0;
+        queue->order[i] = i;
+        queue->order_pos[i] = i;
     }
 
-    unsigned char *new_visited = (unsigned char *)realloc(queue->visited, needed * sizeof(unsigned char));
-    if (!new_visited)
-        return -1;
+    for (size_t i = queue->count; i > 1; i--)
+    {
+        queue_order_swap(queue, i - 1, queue_random_below(queue, i));
+    }
 
-    if (needed > queue->count)
+    queue->order_played = 0;
+    queue->shuffle_next = -1;
+
+    if (first >= 0 && (size_t)first < queue->count)
     {
-        memset(new_visited + queue->count, 0, needed - queue->count);
+        queue_order_swap(queue, queue->order_pos[first], 0);
+        queue->order_played = 1;
     }
 
-    queue->visited = new_visited;
     return 0;
 }
 
-static void queue_reset_visited(Queue *queue)
+/**
+ * Keep the shuffle cursor in step with the current item: an unplayed item
+ * moves up to the cursor, a played one rewinds the cursor to it.
+ */
+static void queue_shuffle_note_current(Queue *queue)
 {
-    if (!queue || !queue->visited)
+    if (!queue->shuffle_enabled || queue->current_index < 0 || (size_t)queue->current_index >= queue->count)
         return;
 
-    memset(queue->visited, 0, queue->count);
+    size_t position = queue->order_pos[queue->current_index];
+    if (position >= queue->order_played)
+    {
+        queue_order_swap(queue, position, queue->order_played);
+        queue->order_played++;
+    }
+    else
+    {
+        queue->order_played = position + 1;
+    }
 }
 
-static void queue_mark_current_visited(Queue *queue)
+/**
+ * First item of the next shuffle cycle, remembered once announced
+ */
+static int queue_shuffle_next_cycle_first(Queue *queue)
 {
-    if (!queue || !queue->visited)
-        return;
+    int first = queue->shuffle_next;
+    if (first >= 0 && (size_t)first < queue->count)
+        return first;
 
-    if (queue->current_index < 0 || (size_t)queue->current_index >= queue->count)
-        return;
+    if (queue->count == 1)
+    {
+        first = 0;
+    }
+    else
+    {
+        // Any item but the one that just played
+        first = (int)queue_random_below(queue, queue->count - 1);
+        if (first >= queue->current_index)
+            first++;
+    }
 
-    queue->visited[queue->current_index] = 1;
+    queue->shuffle_next = first;
+    return first;
 }
 
 static void queue_history_clear(Queue *queue)
@@ -113,26 +242,40 @@ static void queue_history_clear(Queue *queue)
     if (!queue)
         return;
 
+    queue->history_start = 0;
     queue->history_count = 0;
 }
 
+/**
+ * Remember a played index. Once the ring is full the oldest entry is
+ * overwritten, so memory stays flat however long playback runs.
+ */
 static int queue_history_push(Queue *queue, int index)
 {
     if (!queue || index < 0)
         return -1;
 
-    if (queue->history_count >= queue->history_capacity)
+    if (queue->history_depth == 0)
+        return 0;
+
+    if (!queue->history)
     {
-        size_t new_capacity = queue->history_capacity > 0 ? queue->history_capacity * 2 : QUEUE_INITIAL_CAPACITY;
-        int *new_history = (int *)realloc(queue->history, new_capacity * sizeof(int));
-        if (!new_history)
+        queue->history = (int *)malloc(queue->history_depth * sizeof(int));
+        if (!queue->history)
             return -1;
+    }
 
-        queue->history = new_history;
-        queue->history_capacity = new_capacity;
+    if (queue->history_count < queue->history_depth)
+    {
+        queue->history[(queue->history_start + queue->history_count) % queue->history_depth] = index;
+        queue->history_count++;
+    }
+    else
+    {
+        queue->history[queue->history_start] = index;
+        queue->history_start = (queue->history_start + 1) % queue->history_depth;
     }
 
-    queue->history[queue->history_count++] = index;
     return 0;
 }
 
@@ -142,36 +285,10 @@ static int queue_history_pop(Queue *queue, int *out_index)
         return -1;
 
     queue->history_count--;
-    *out_index = queue->history[queue->history_count];
+    *out_index = queue->history[(queue->history_start + queue->history_count) % queue->history_depth];
     return 0;
 }
 
-static int queue_pick_random_unvisited(const Queue *queue, int exclude_current)
-{
-    if (!queue || !queue->visited || queue->count == 0)
-        return -1;
-
-    int chosen = -1;
-    int seen = 0;
-
-    for (size_t i = 0; i < queue->count; i++)
-    {
-        if (queue->visited[i])
-            continue;
-
-        if (exclude_current && queue->count > 1 && (int)i == queue->current_index)
-            continue;
-
-        seen++;
-        if ((rand() % seen) == 0)
-        {
-            chosen = (int)i;
-        }
-    }
-
-    return chosen;
-}
-
 static QueueNextResult queue_select_next(Queue *queue, int *out_index, int respect_repeat_single)
 {
     if (!queue || !out_index)
@@ -210,75 +327,41 @@ static QueueNextResult queue_select_next(Queue *queue, int *out_index, int respe
         return QUEUE_NEXT_STOP;
     }
 
-    queue_mark_current_visited(queue);
-
-    int next = queue_pick_random_unvisited(queue, 1);
-    if (next >= 0)
+    // The caller's queue_set_current_index() moves the cursor past the pick
+    if (queue->order_played < queue->count)
     {
         if (queue_history_push(queue, queue->current_index) != 0)
             return QUEUE_NEXT_ERROR;
-        *out_index = next;
+        *out_index = (int)queue->order[queue->order_played];
         return QUEUE_NEXT_PLAY;
     }
 
     if (queue->repeat_mode == QUEUE_REPEAT_ALL)
     {
-        queue_reset_visited(queue);
-        queue_mark_current_visited(queue);
-
-        next = queue_pick_random_unvisited(queue, 1);
-        if (next >= 0)
-        {
-            if (queue_history_push(queue, queue->current_index) != 0)
-                return QUEUE_NEXT_ERROR;
-            *out_index = next;
-            return QUEUE_NEXT_PLAY;
-        }
-
-        // Single-item queue in repeat-all shuffle mode.
-        *out_index = queue->current_index;
+        int first = queue_shuffle_next_cycle_first(queue);
+        if (queue_history_push(queue, queue->current_index) != 0)
+            return QUEUE_NEXT_ERROR;
+        if (queue_shuffle_build(queue, first) != 0)
+            return QUEUE_NEXT_ERROR;
+        *out_index = first;
         return QUEUE_NEXT_PLAY;
     }
 
     return QUEUE_NEXT_STOP;
 }
 
-static int queue_path_join(const char *folderpath, const char *name, char *out, size_t out_size)
-{
-    if (!folderpath || !name || !out || out_size == 0)
-        return -1;
-
-    size_t folder_len = strlen(folderpath);
-    int needs_separator = (folder_len > 0 && folderpath[folder_len - 1] != '/');
-
-    int written = snprintf(out, out_size, "%s%s%s", folderpath, needs_separator ? "/" : "", name);
-    if (written < 0 || (size_t)written >= out_size)
-        return -1;
-
-    return 0;
-}
-
-static int queue_is_regular_file(const char *path)
-{
-    struct stat st;
-    if (!path)
-        return 0;
-    if (stat(path, &st) != 0)
-        return 0;
-    return S_ISREG(st.st_mode) ? 1 : 0;
-}
-
 static int queue_compare_paths(const void *a, const void *b)
 {
     const char *const *path_a = (const char *const *)a;
     const char *const *path_b = (const char *const *)b;
-    return strcasecmp(*path_a, *path_b);
+    int order = strcasecmp(*path_a, *path_b);
+
+    // Break case-only ties so the order never depends on scan order
+    return order != 0 ? order : strcmp(*path_a, *path_b);
 }
 
 Queue *queue_create(void)
 {
-    queue_seed_rng_once();
-
     Queue *queue = (Queue *)malloc(sizeof(Queue));
     if (!queue)
         return NULL;
@@ -290,10 +373,19 @@ Queue *queue_create(void)
     queue->repeat_mode = QUEUE_REPEAT_OFF;
     queue->shuffle_enabled = 0;
     queue->last_played_index = -1;
-    queue->visited = NULL;
+    queue->order = NULL;
+    queue->order_pos = NULL;
+    queue->order_capacity = 0;
+    queue->order_played = 0;
+    queue->shuffle_next = -1;
     queue->history = NULL;
+    queue->history_start = 0;
     queue->history_count = 0;
-    queue->history_capacity = 0;
+    queue->history_depth = QUEUE_HISTORY_DEFAULT_DEPTH;
+    queue->scan_cache = NULL;
+    queue->arena_head = NULL;
+    queue->arena_current = NULL;
+    queue_set_shuffle_seed(queue, 0);
 
     return queue;
 }
@@ -303,16 +395,13 @@ void queue_clear(Queue *queue)
     if (!queue)
         return;
 
-    for (size_t i = 0; i < queue->count; i++)
-    {
-        free(queue->items[i]);
-    }
+    queue_arena_rewind(queue);
 
     queue->count = 0;
     queue->current_index = -1;
     queue->last_played_index = -1;
-    free(queue->visited);
-    queue->visited = NULL;
+    queue->order_played = 0;
+    queue->shuffle_next = -1;
     queue_history_clear(queue);
 }
 
@@ -322,7 +411,18 @@ void queue_destroy(Queue *queue)
         return;
 
     queue_clear(queue);
+
+    QueueArenaChunk *chunk = queue->arena_head;
+    while (chunk)
+    {
+        QueueArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
     free(queue->items);
+    free(queue->order);
+    free(queue->order_pos);
     free(queue->history);
     free(queue);
 }
@@ -349,133 +449,130 @@ int queue_is_audio_file(const char *path)
 
 int queue_enqueue(Queue *queue, const char *filepath)
 {
-    if (!queue || !filepath || !queue_is_audio_file(filepath))
-        return -1;
-
-    if (queue_ensure_capacity(queue, queue->count + 1) != 0)
-        return -1;
-
-    char *copy = queue_strdup(filepath);
-    if (!copy)
+    if (!filepath)
         return -1;
 
-    queue->items[queue->count++] = copy;
-
-    if (queue_ensure_visited_capacity(queue, queue->count) != 0)
-    {
-        free(queue->items[queue->count - 1]);
-        queue->count--;
-        return -1;
-    }
-
-    queue->visited[queue->count - 1] = 0;
-
-    if (queue->current_index < 0)
-    {
-        queue->current_index = 0;
-        queue_mark_current_visited(queue);
-    }
-
-    return 0;
+    return queue_enqueue_batch(queue, &filepath, 1) == 1 ? 0 : -1;
 }
 
-int queue_load_folder(Queue *queue, const char *folderpath)
+int queue_enqueue_batch(Queue *queue, const char *const *filepaths, size_t count)
 {
-    if (!queue || !folderpath)
+    if (!queue || (!filepaths && count > 0))
         return -1;
 
-    DIR *dir = opendir(folderpath);
-    if (!dir)
+    // Grow once for the whole batch; skipped files just leave spare room
+    if (queue_ensure_capacity(queue, queue->count + count) != 0)
         return -1;
 
-    size_t found_count = 0;
-    size_t found_capacity = QUEUE_INITIAL_CAPACITY;
-    char **found = (char **)malloc(found_capacity * sizeof(char *));
-    if (!found)
-    {
-        closedir(dir);
+    if (queue->shuffle_enabled && queue_order_reserve(queue, queue->count + count) != 0)
         return -1;
-    }
-
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL)
-    {
-        const char *name = entry->d_name;
 
-        if (!name || name[0] == '.')
-            continue;
+    size_t first_added = queue->count;
 
-        if (!queue_is_audio_file(name))
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!filepaths[i] || !queue_is_audio_file(filepaths[i]))
             continue;
 
-        char full_path[PATH_MAX];
-        if (queue_path_join(folderpath, name, full_path, sizeof(full_path)) != 0)
-            continue;
+        char *copy = queue_arena_strdup(queue, filepaths[i]);
+        if (!copy)
+            return -1;
 
-        if (!queue_is_regular_file(full_path))
-            continue;
+        size_t added = queue->count;
+        queue->items[queue->count++] = copy;
 
-        if (found_count >= found_capacity)
+        if (queue->shuffle_enabled)
         {
-            size_t new_capacity = found_capacity * 2;
-            char **new_found = (char **)realloc(found, new_capacity * sizeof(char *));
-            if (!new_found)
-            {
-                for (size_t i = 0; i < found_count; i++)
-                    free(found[i]);
-                free(found);
-                closedir(dir);
-                return -1;
-            }
-            found = new_found;
-            found_capacity = new_capacity;
+            // Slot the new item into the unplayed part of the permutation, after
+            // the announced next pick so a preloaded track stays valid
+            size_t lowest = queue->order_played + 1 < added ? queue->order_played + 1 : added;
+            queue->order[added] = added;
+            queue->order_pos[added] = added;
+            queue_order_swap(queue, added, lowest + queue_random_below(queue, added - lowest + 1));
         }
+    }
 
-        found[found_count] = queue_strdup(full_path);
-        if (!found[found_count])
-        {
-            for (size_t i = 0; i < found_count; i++)
-                free(found[i]);
-            free(found);
-            closedir(dir);
-            return -1;
-        }
-        found_count++;
+    if (queue->current_index < 0 && queue->count > 0)
+    {
+        queue->current_index = 0;
+        queue_shuffle_note_current(queue);
     }
 
-    closedir(dir);
+    return (int)(queue->count - first_added);
+}
 
-    qsort(found, found_count, sizeof(char *), queue_compare_paths);
+int queue_load_paths(Queue *queue, const char *const *filepaths, size_t count)
+{
+    if (!queue || (!filepaths && count > 0))
+        return -1;
+
+    // Nothing to play: keep the old queue, since clearing it rewinds the
+    // arena that the playing track's path still points into
+    size_t playable = 0;
+    for (size_t i = 0; i < count && playable == 0; i++)
+        playable += filepaths[i] && queue_is_audio_file(filepaths[i]);
+    if (playable == 0)
+        return 0;
 
     queue_clear(queue);
 
-    if (queue_ensure_capacity(queue, found_count) != 0)
+    int loaded = queue_enqueue_batch(queue, filepaths, count);
+    if (loaded < 0)
     {
-        for (size_t i = 0; i < found_count; i++)
-            free(found[i]);
-        free(found);
+        queue_clear(queue);
         return -1;
     }
 
-    for (size_t i = 0; i < found_count; i++)
-    {
-        queue->items[i] = found[i];
-    }
-
-    queue->count = found_count;
     queue->current_index = -1;
+    queue->last_played_index = -1;
 
-    if (queue_ensure_visited_capacity(queue, queue->count) != 0)
+    if (queue->shuffle_enabled && queue_shuffle_build(queue, -1) != 0)
     {
         queue_clear(queue);
         return -1;
     }
 
-    queue_reset_visited(queue);
+    return loaded;
+}
 
-    free(found);
+/**
+ * Replace queue contents with the audio files found by the scanner
+ */
+static int queue_load_scanned(Queue *queue, const char *folderpath, int recursive)
+{
+    if (!queue || !folderpath)
+        return -1;
+
+    char **found = NULL;
+    int scanned = scanner_scan(folderpath, recursive, queue_is_audio_file, queue->scan_cache, &found);
+    if (scanned < 0)
+        return -1;
+
+    size_t found_count = (size_t)scanned;
+    qsort(found, found_count, sizeof(char *), queue_compare_paths);
+
+    // Sorted first, so the arena holds the paths in playback order
+    int loaded = queue_load_paths(queue, (const char *const *)found, found_count);
+    scanner_free(found, found_count);
+    return loaded;
+}
+
+int queue_load_folder(Queue *queue, const char *folderpath)
+{
+    return queue_load_scanned(queue, folderpath, 0);
+}
+
+int queue_load_folder_recursive(Queue *queue, const char *folderpath)
+{
+    return queue_load_scanned(queue, folderpath, 1);
+}
+
+void queue_set_scan_cache(Queue *queue, const ScannerCache *cache)
+{
+    if (!queue)
+        return;
 
-    return (int)found_count;
+    queue->scan_cache = cache;
 }
 
 size_t queue_count(const Queue *queue)
@@ -513,7 +610,7 @@ int queue_set_current_index(Queue *queue, int index)
 
     queue->current_index = index;
     queue->last_played_index = index;
-    queue_mark_current_visited(queue);
+    queue_shuffle_note_current(queue);
     return 0;
 }
 
@@ -579,9 +676,65 @@ void queue_set_shuffle(Queue *queue, int enabled)
         return;
 
     queue->shuffle_enabled = enabled ? 1 : 0;
+    queue->shuffle_next = -1;
     queue_history_clear(queue);
-    queue_reset_visited(queue);
-    queue_mark_current_visited(queue);
+
+    // A fresh cycle starts from whatever is playing now
+    if (queue->shuffle_enabled && queue_shuffle_build(queue, queue->current_index) != 0)
+        queue->shuffle_enabled = 0;
+}
+
+void queue_set_shuffle_seed(Queue *queue, unsigned long seed)
+{
+    if (!queue)
+        return;
+
+    uint64_t state = seed != 0 ? (uint64_t)seed : (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+
+    // Spread small seeds over all bits; xorshift must never start at zero
+    state = (state ^ (state >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    state = (state ^ (state >> 27)) * 0x94D049BB133111EBULL;
+    state ^= state >> 31;
+    queue->rng_state = state != 0 ? state : 0x9E3779B97F4A7C15ULL;
+}
+
+void queue_set_history_depth(Queue *queue, size_t depth)
+{
+    if (!queue || depth == queue->history_depth)
+        return;
+
+    int *history = NULL;
+    if (depth > 0 && queue->history_count > 0)
+    {
+        history = (int *)malloc(depth * sizeof(int));
+        if (!history)
+            return;
+    }
+
+    // Keep the most recent entries, oldest first
+    size_t keep = queue->history_count < depth ? queue->history_count : depth;
+    size_t skip = queue->history_count - keep;
+    for (size_t i = 0; i < keep; i++)
+    {
+        history[i] = queue->history[(queue->history_start + skip + i) % queue->history_depth];
+    }
+
+    free(queue->history);
+    queue->history = history;
+    queue->history_start = 0;
+    queue->history_count = keep;
+    queue->history_depth = depth;
+}
+
+int queue_pick_start_index(Queue *queue)
+{
+    if (!queue || queue->count == 0)
+        return -1;
+
+    if (queue->shuffle_enabled && queue->order_played == 0)
+        return (int)queue->order[0];
+
+    return 0;
 }
 
 int queue_toggle_shuffle(Queue *queue)
@@ -593,11 +746,73 @@ int queue_toggle_shuffle(Queue *queue)
     return queue->shuffle_enabled;
 }
 
+int queue_is_last_in_cycle(const Queue *queue)
+{
+    if (!queue || queue->current_index < 0 || (size_t)queue->current_index >= queue->count)
+        return 0;
+
+    // The shuffle cursor sits just past the current item
+    if (queue->shuffle_enabled)
+        return queue->order_played >= queue->count;
+
+    return (size_t)queue->current_index + 1 == queue->count;
+}
+
 QueueNextResult queue_get_next_on_end(Queue *queue, int *out_index)
 {
     return queue_select_next(queue, out_index, 1);
 }
 
+QueueNextResult queue_peek_next_on_end(Queue *queue, int *out_index)
+{
+    if (!queue || !out_index)
+        return QUEUE_NEXT_ERROR;
+
+    if (queue->count == 0)
+        return QUEUE_NEXT_STOP;
+
+    if (queue->current_index < 0 || (size_t)queue->current_index >= queue->count)
+        return QUEUE_NEXT_ERROR;
+
+    if (queue->repeat_mode == QUEUE_REPEAT_SINGLE)
+    {
+        *out_index = queue->current_index;
+        return QUEUE_NEXT_PLAY;
+    }
+
+    if (!queue->shuffle_enabled)
+    {
+        if ((size_t)(queue->current_index + 1) < queue->count)
+        {
+            *out_index = queue->current_index + 1;
+            return QUEUE_NEXT_PLAY;
+        }
+
+        if (queue->repeat_mode == QUEUE_REPEAT_ALL)
+        {
+            *out_index = 0;
+            return QUEUE_NEXT_PLAY;
+        }
+
+        return QUEUE_NEXT_STOP;
+    }
+
+    if (queue->order_played < queue->count)
+    {
+        *out_index = (int)queue->order[queue->order_played];
+        return QUEUE_NEXT_PLAY;
+    }
+
+    if (queue->repeat_mode == QUEUE_REPEAT_ALL)
+    {
+        // Announce the next cycle's first pick so queue_get_next_on_end() agrees
+        *out_index = queue_shuffle_next_cycle_first(queue);
+        return QUEUE_NEXT_PLAY;
+    }
+
+    return QUEUE_NEXT_STOP;
+}
+
 QueueNextResult queue_get_next_manual(Queue *queue, int *out_index)
 {
     return queue_select_next(queue, out_index, 0);
@@ -619,13 +834,10 @@ QueueNextResult queue_get_previous(Queue *queue, int *out_index)
 
             // If we are restoring playback from ended state in shuffle mode and
             // there is no rewind history left, treat this as a fresh cycle start.
-            if (queue->shuffle_enabled && queue->history_count == 0)
+            if (queue->shuffle_enabled && queue->history_count == 0 &&
+                queue_shuffle_build(queue, *out_index) != 0)
             {
-                queue_reset_visited(queue);
-                if (queue->visited)
-                {
-                    queue->visited[*out_index] = 1;
-                }
+                return QUEUE_NEXT_ERROR;
             }
 
             return QUEUE_NEXT_PLAY;
@@ -643,13 +855,10 @@ QueueNextResult queue_get_previous(Queue *queue, int *out_index)
 
         // Reached the beginning of rewind history: make next-track restart from
         // this point in shuffle mode instead of immediately ending.
-        if (queue->shuffle_enabled && queue->history_count == 0)
+        if (queue->shuffle_enabled && queue->history_count == 0 &&
+            queue_shuffle_build(queue, *out_index) != 0)
         {
-            queue_reset_visited(queue);
-            if (queue->visited)
-            {
-                queue->visited[*out_index] = 1;
-            }
+            return QUEUE_NEXT_ERROR;
         }
 
         return QUEUE_NEXT_PLAY;
@@ -9,6 +9,8 @@
 #define WALCMAN_QUEUE_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include "scanner.h"
 
 // Repeat behavior for queued playback.
 typedef enum
@@ -26,19 +28,31 @@ typedef enum
     QUEUE_NEXT_PLAY = 1
 } QueueNextResult;
 
+// Chunk of the queue's path storage (see queue.c)
+typedef struct QueueArenaChunk QueueArenaChunk;
+
 typedef struct Queue
 {
-    char **items;
+    char **items; // Paths, stored in the arena below
     size_t count;
     size_t capacity;
     int current_index;
     QueueRepeatMode repeat_mode;
     int shuffle_enabled;
     int last_played_index;
-    unsigned char *visited;
-    int *history;
+    size_t *order;       // Shuffle permutation of item indices
+    size_t *order_pos;   // Position of each item in order
+    size_t order_capacity;
+    size_t order_played; // order[0..order_played-1] played this cycle
+    uint64_t rng_state;
+    int shuffle_next; // First pick of the next shuffle cycle once announced, or -1
+    int *history;         // Ring of played indices for queue_get_previous()
+    size_t history_start; // Oldest entry in the ring
     size_t history_count;
-    size_t history_capacity;
+    size_t history_depth; // Ring capacity; older entries are dropped
+    const ScannerCache *scan_cache; // Listing cache for folder loads, or NULL
+    QueueArenaChunk *arena_head;    // First chunk of path storage
+    QueueArenaChunk *arena_current; // Chunk new paths are copied into
 } Queue;
 
 /**
@@ -49,6 +63,8 @@ void queue_destroy(Queue *queue);
 
 /**
  * Remove all queued items and reset state.
+ * Path storage is kept for reuse, so this is O(1) in the item count;
+ * pointers from queue_get_item() are invalid afterwards.
  */
 void queue_clear(Queue *queue);
 
@@ -58,13 +74,45 @@ void queue_clear(Queue *queue);
  */
 int queue_enqueue(Queue *queue, const char *filepath);
 
+/**
+ * Add several file paths to the queue, growing storage once for all of
+ * them. Paths that are not audio files are skipped.
+ * Returns number of paths added, or -1 on allocation failure (paths added
+ * before the failure stay queued).
+ */
+int queue_enqueue_batch(Queue *queue, const char *const *filepaths, size_t count);
+
+/**
+ * Replace queue contents with the given files, in the given order.
+ * Paths without an audio extension are skipped; if none is left the
+ * queue is kept as it is.
+ * Returns number of loaded files, or -1 on failure.
+ */
+int queue_load_paths(Queue *queue, const char *const *filepaths, size_t count);
+
 /**
  * Replace queue contents with playable files from folder.
  * Files are added in deterministic (alphabetical) order.
+ * A folder without playable files leaves the queue as it is.
  * Returns number of loaded files, or -1 on failure.
  */
 int queue_load_folder(Queue *queue, const char *folderpath);
 
+/**
+ * Replace queue contents with playable files from folder and all of its
+ * subfolders, scanned in parallel.
+ * Files are sorted by full path, so albums stay together and in order.
+ * A folder without playable files leaves the queue as it is.
+ * Returns number of loaded files, or -1 on failure.
+ */
+int queue_load_folder_recursive(Queue *queue, const char *folderpath);
+
+/**
+ * Use a listing cache (e.g. the library index) for folder loads.
+ * cache: Cache to use, or NULL to always list directories from disk
+ */
+void queue_set_scan_cache(Queue *queue, const ScannerCache *cache);
+
 /**
  * Read-only queue accessors.
  */
@@ -98,6 +146,33 @@ int queue_get_shuffle(const Queue *queue);
 int queue_toggle_shuffle(Queue *queue);
 void queue_set_shuffle(Queue *queue, int enabled);
 
+/**
+ * Seed the shuffle order. The same seed and queue give the same order.
+ * seed: Seed value, or 0 to seed from the clock
+ */
+void queue_set_shuffle_seed(Queue *queue, unsigned long seed);
+
+/**
+ * Set how many played tracks queue_get_previous() can step back through.
+ * The most recent entries are kept when the depth shrinks.
+ * depth: Number of entries (default 1000), 0 disables history
+ */
+void queue_set_history_depth(Queue *queue, size_t depth);
+
+/**
+ * Index to start a freshly loaded queue at: the first item of the
+ * shuffle order when shuffling, otherwise 0.
+ * Returns -1 if the queue is empty.
+ */
+int queue_pick_start_index(Queue *queue);
+
+/**
+ * Check whether the current item is the last one of a pass through the
+ * queue, i.e. the next item on end would start the queue over (or stop).
+ * Returns 1 if it is, 0 otherwise or if there is no current item.
+ */
+int queue_is_last_in_cycle(const Queue *queue);
+
 /**
  * Decide what index to play after current item ends.
  * Returns QUEUE_NEXT_PLAY and sets out_index when another item should play.
@@ -106,6 +181,16 @@ void queue_set_shuffle(Queue *queue, int enabled);
  */
 QueueNextResult queue_get_next_on_end(Queue *queue, int *out_index);
 
+/**
+ * Report what index queue_get_next_on_end() will choose, without advancing.
+ * In shuffle mode this is the next item of the stored permutation, so the
+ * following queue_get_next_on_end() call returns the same index.
+ * Returns QUEUE_NEXT_PLAY and sets out_index when another item would play.
+ * Returns QUEUE_NEXT_STOP when playback would stop.
+ * Returns QUEUE_NEXT_ERROR for invalid arguments/state.
+ */
+QueueNextResult queue_peek_next_on_end(Queue *queue, int *out_index);
+
 /**
  * Decide what index to play for manual next-track action.
  * Returns QUEUE_NEXT_PLAY and sets out_index when another item should play.
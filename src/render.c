@@ -0,0 +1,166 @@
+/**
+ * render.c - Offline rendering implementation
+ *
+ * The loop mirrors the interactive main loop: player events are handled
+ * between blocks, and the player refuses to mix while a load is pending,
+ * so loading time never turns into silence in the file. Blocks end with
+ * each track, so the file stops on the last track's final frame rather
+ * than on a block boundary, which keeps it loopable. A track that cannot
+ * be loaded is skipped like one that ended, and counted as failed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+#include "miniaudio.h"
+#include "render.h"
+#include "error.h"
+#include "util.h"
+
+#define RENDER_BLOCK_FRAMES 4096
+#define RENDER_MAX_FRAMES ((0xFFFFFFFFULL - 1024) / (RENDER_CHANNELS * sizeof(float))) // RIFF sizes are 32-bit
+
+// Progress through the requested passes
+typedef struct RenderPasses
+{
+    int total;    // Passes requested
+    int finished; // Times the queue was played through (or skipped through)
+} RenderPasses;
+
+/**
+ * Move on from the current track, counting a finished pass when the queue
+ * starts over. Repeat all is switched off for the last pass, so the queue
+ * stops at its end.
+ */
+static void render_next_track(AppController *controller, RenderPasses *passes)
+{
+    Queue *queue = controller->queue;
+
+    if (queue_is_last_in_cycle(queue))
+        passes->finished++;
+
+    app_controller_handle_track_end(controller);
+
+    if (passes->finished == passes->total - 1 && queue_get_repeat_mode(queue) == QUEUE_REPEAT_ALL)
+    {
+        int next_index = -1;
+        queue_set_repeat_mode(queue, QUEUE_REPEAT_OFF);
+        if (queue_peek_next_on_end(queue, &next_index) == QUEUE_NEXT_STOP)
+            player_cancel_preload(controller->player);
+    }
+}
+
+/**
+ * Handle player events between blocks, as the main loop would, and skip
+ * tracks that fail to load
+ */
+static void render_handle_events(AppController *controller, RenderPasses *passes, RenderStats *stats)
+{
+    Player *player = controller->player;
+    Queue *queue = controller->queue;
+
+    player_drain_events(player);
+    player_refresh_gain(player);
+
+    // A failed load clears the queue position; put it back to move past the track
+    int index = queue_get_current_index(queue);
+    if (app_controller_poll_load(controller) < 0)
+    {
+        stats->failed++;
+        if (index >= 0 && queue_set_current_index(queue, index) == 0)
+            render_next_track(controller, passes);
+        return;
+    }
+
+    int ended = player_take_track_end(player);
+    if (!ended || player_get_state(player) != STATE_PLAYING)
+        return;
+
+    stats->tracks++;
+    render_next_track(controller, passes);
+}
+
+int render_queue(AppController *controller, const char *out_path, int passes, RenderStats *out)
+{
+    if (!controller || !out_path)
+        return -1;
+
+    Player *player = controller->player;
+    RenderPasses progress = {passes < 1 ? 1 : passes, 0};
+
+    // Repeat all wraps the queue around until the last pass starts
+    queue_set_repeat_mode(controller->queue, progress.total > 1 ? QUEUE_REPEAT_ALL : QUEUE_REPEAT_OFF);
+
+    ma_encoder_config config = ma_encoder_config_init(ma_encoding_format_wav, ma_format_f32, RENDER_CHANNELS,
+                                                      RENDER_SAMPLE_RATE);
+    ma_encoder encoder;
+    if (ma_encoder_init_file(out_path, &config, &encoder) != MA_SUCCESS)
+    {
+        error_print(ERR_FILE_LOAD, out_path);
+        return -1;
+    }
+
+    float *block = (float *)malloc(RENDER_BLOCK_FRAMES * RENDER_CHANNELS * sizeof(float));
+    if (!block)
+    {
+        ma_encoder_uninit(&encoder);
+        return -1;
+    }
+
+    RenderStats stats = {0};
+    double start_ms = util_time_ms();
+    struct pollfd fd = {player_get_event_fd(player), POLLIN, 0};
+    int result = 0;
+
+    for (;;)
+    {
+        render_handle_events(controller, &progress, &stats);
+
+        PlayerState state = player_get_state(player);
+        if (state == STATE_STOPPED)
+            break;
+
+        int mixed = player_render(player, block, RENDER_BLOCK_FRAMES);
+        if (mixed < 0)
+        {
+            result = -1;
+            break;
+        }
+
+        // A load is still running, or the end of the last track is on its way
+        if (mixed == 0)
+        {
+            poll(&fd, 1, 100);
+            continue;
+        }
+
+        // About 3.1 hours at 48 kHz stereo
+        if (stats.frames + (unsigned long long)mixed > RENDER_MAX_FRAMES)
+        {
+            error_print(ERR_FILE_LOAD, "Render stopped at the 4 GB WAV size limit");
+            result = -1;
+            break;
+        }
+
+        ma_uint64 written = 0;
+        if (ma_encoder_write_pcm_frames(&encoder, block, (ma_uint64)mixed, &written) != MA_SUCCESS ||
+            written != (ma_uint64)mixed)
+        {
+            error_print(ERR_FILE_LOAD, out_path);
+            result = -1;
+            break;
+        }
+        stats.frames += written;
+    }
+
+    free(block);
+    ma_encoder_uninit(&encoder);
+
+    stats.audio_seconds = (double)stats.frames / RENDER_SAMPLE_RATE;
+    stats.render_seconds = (util_time_ms() - start_ms) / 1000.0;
+    if (out)
+        *out = stats;
+
+    // The file is complete apart from the skipped tracks, but not what was asked for
+    return stats.failed > 0 ? -1 : result;
+}
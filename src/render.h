@@ -0,0 +1,43 @@
+/**
+ * render.h - Offline rendering of the queue to a WAV file
+ *
+ * Plays the queue through an offline player (no output device) and writes
+ * the mix to disk as fast as the decoders allow. Tracks follow each other
+ * exactly as they would on the speakers: same queue order, gapless starts,
+ * crossfades and per-track gain, so a render doubles as a device-free
+ * end-to-end test of the decode path.
+ */
+
+#ifndef WALCMAN_RENDER_H
+#define WALCMAN_RENDER_H
+
+#include "app_controller.h"
+
+#define RENDER_SAMPLE_RATE 48000
+#define RENDER_CHANNELS 2
+#define RENDER_PASSES_MAX 1000 // Upper bound for --passes
+
+// Result of one render
+typedef struct RenderStats
+{
+    unsigned long tracks;        // Tracks that played to their end
+    unsigned long failed;        // Tracks that could not be loaded and were skipped
+    unsigned long long frames;   // Frames written
+    double audio_seconds;        // Audio written
+    double render_seconds;       // Wall time spent
+} RenderStats;
+
+/**
+ * Render the controller's queue until playback stops
+ * controller: Controller of a player from player_create_offline() with
+ *             RENDER_SAMPLE_RATE and RENDER_CHANNELS; a track should
+ *             already be playing or loading
+ * out_path: WAV file to write (32-bit float)
+ * passes: Times the queue is played through (1 to RENDER_PASSES_MAX)
+ * out: Receives the result (may be NULL)
+ * Returns: 0 on success, -1 if the file cannot be written, mixing failed
+ *          or tracks had to be skipped (the rest is still rendered)
+ */
+int render_queue(AppController *controller, const char *out_path, int passes, RenderStats *out);
+
+#endif // WALCMAN_RENDER_H
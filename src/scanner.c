@@ -0,0 +1,520 @@
+/**
+ * scanner.c - Directory scanner implementation
+ *
+ * Directories are work items on a shared stack. Each worker lists one
+ * directory at a time, using d_type to classify entries and only falling
+ * back to fstatat() (relative to the directory fd) when the filesystem does
+ * not report a type or the entry is a symlink. Subdirectories are opened
+ * with openat() while the parent is still open, and queued with their fd.
+ *
+ * Each worker collects matches in its own list; the lists are concatenated
+ * when the walk is done, so workers never contend on the results.
+ *
+ * With a ScannerCache, every directory is stat()ed first and an unchanged
+ * one is replayed from the cache instead of being listed again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "scanner.h"
+#include "config.h"
+
+#define SCANNER_INITIAL_CAPACITY 64
+#define SCANNER_DEFAULT_THREADS 4
+#define SCANNER_MAX_THREADS 16
+#define SCANNER_MAX_OPEN_DIRS 64 // Queued directories beyond this are reopened by path
+
+#ifndef O_DIRECTORY
+#define O_DIRECTORY 0
+#endif
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+// A directory waiting to be listed
+typedef struct
+{
+    char *path; // Full path (owned)
+    int fd;     // Open directory fd, or -1 to open by path
+} ScannerDir;
+
+// Growable list of owned path strings
+typedef struct
+{
+    char **items;
+    size_t count;
+    size_t capacity;
+} ScannerList;
+
+// State shared by the workers of one scan
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    ScannerDir *dirs;     // Stack of directories to list
+    size_t dir_count;
+    size_t dir_capacity;
+    size_t open_dirs;     // Queued directories holding an fd
+    size_t busy;          // Workers currently listing a directory
+    int recursive;
+    int failed;           // Set on allocation failure; stops the walk
+    ScannerFilter filter;
+    const ScannerCache *cache; // Optional listing cache
+} ScannerShared;
+
+// Receives the entries of one directory, listed or taken from the cache
+struct ScannerSink
+{
+    ScannerShared *shared;
+    ScannerList *out;  // Worker's result list
+    const char *path;  // Directory path
+    int dir_fd;        // Directory fd for openat(), or -1
+    size_t name_start; // Offset of the file name in joined paths
+    int failed;        // Set on allocation failure
+};
+
+static int scanner_list_push(ScannerList *list, char *path)
+{
+    if (list->count >= list->capacity)
+    {
+        size_t new_capacity = list->capacity > 0 ? list->capacity * 2 : SCANNER_INITIAL_CAPACITY;
+        char **new_items = (char **)realloc(list->items, new_capacity * sizeof(char *));
+        if (!new_items)
+            return -1;
+
+        list->items = new_items;
+        list->capacity = new_capacity;
+    }
+
+    list->items[list->count++] = path;
+    return 0;
+}
+
+static char *scanner_path_join(const char *folderpath, const char *name)
+{
+    size_t folder_len = strlen(folderpath);
+    size_t name_len = strlen(name);
+    int needs_separator = (folder_len > 0 && folderpath[folder_len - 1] != '/');
+
+    char *path = (char *)malloc(folder_len + needs_separator + name_len + 1);
+    if (!path)
+        return NULL;
+
+    memcpy(path, folderpath, folder_len);
+    if (needs_separator)
+        path[folder_len] = '/';
+    memcpy(path + folder_len + needs_separator, name, name_len + 1);
+    return path;
+}
+
+/**
+ * Queue a directory for listing (lock held)
+ * Returns 0 on success, -1 on allocation failure
+ */
+static int scanner_push_dir(ScannerShared *shared, char *path, int fd)
+{
+    if (shared->dir_count >= shared->dir_capacity)
+    {
+        size_t new_capacity = shared->dir_capacity > 0 ? shared->dir_capacity * 2 : SCANNER_INITIAL_CAPACITY;
+        ScannerDir *new_dirs = (ScannerDir *)realloc(shared->dirs, new_capacity * sizeof(ScannerDir));
+        if (!new_dirs)
+            return -1;
+
+        shared->dirs = new_dirs;
+        shared->dir_capacity = new_capacity;
+    }
+
+    shared->dirs[shared->dir_count].path = path;
+    shared->dirs[shared->dir_count].fd = fd;
+    shared->dir_count++;
+    if (fd >= 0)
+        shared->open_dirs++;
+
+    return 0;
+}
+
+/**
+ * Classify a directory entry without stat() when d_type allows it
+ * Returns 1 for a regular file, 2 for a directory to descend into, 0 otherwise
+ */
+static int scanner_entry_kind(int dir_fd, const struct dirent *entry)
+{
+#ifdef DT_UNKNOWN
+    if (entry->d_type == DT_REG)
+        return 1;
+    if (entry->d_type == DT_DIR)
+        return 2;
+    if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK)
+        return 0;
+#endif
+
+    // Unknown type or symlink: follow it, but never descend through a link
+    struct stat st;
+    if (fstatat(dir_fd, entry->d_name, &st, 0) != 0)
+        return 0;
+
+    if (S_ISREG(st.st_mode))
+        return 1;
+
+#ifdef DT_LNK
+    if (entry->d_type == DT_LNK)
+        return 0;
+#endif
+
+    return S_ISDIR(st.st_mode) ? 2 : 0;
+}
+
+static long long scanner_mtime_ns(const struct stat *st)
+{
+#ifdef __APPLE__
+    return (long long)st->st_mtimespec.tv_sec * 1000000000LL + st->st_mtimespec.tv_nsec;
+#else
+    return (long long)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+#endif
+}
+
+int scanner_sink_add_file(ScannerSink *sink, const char *name)
+{
+    if (!sink || !name || sink->failed)
+        return -1;
+
+    if (sink->shared->filter && !sink->shared->filter(name))
+        return 0;
+
+    char *full_path = scanner_path_join(sink->path, name);
+    if (!full_path || scanner_list_push(sink->out, full_path) != 0)
+    {
+        free(full_path);
+        sink->failed = 1;
+        return -1;
+    }
+
+    sink->name_start = strlen(full_path) - strlen(name);
+    return 0;
+}
+
+int scanner_sink_add_subdir(ScannerSink *sink, const char *name)
+{
+    if (!sink || !name || sink->failed)
+        return -1;
+
+    ScannerShared *shared = sink->shared;
+    if (!shared->recursive)
+        return 0;
+
+    char *full_path = scanner_path_join(sink->path, name);
+    if (!full_path)
+    {
+        sink->failed = 1;
+        return -1;
+    }
+
+    pthread_mutex_lock(&shared->lock);
+    int sub_fd = -1;
+    if (sink->dir_fd >= 0 && shared->open_dirs < SCANNER_MAX_OPEN_DIRS)
+        sub_fd = openat(sink->dir_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (scanner_push_dir(shared, full_path, sub_fd) != 0)
+    {
+        pthread_mutex_unlock(&shared->lock);
+        if (sub_fd >= 0)
+            close(sub_fd);
+        free(full_path);
+        sink->failed = 1;
+        return -1;
+    }
+    pthread_cond_signal(&shared->cond);
+    pthread_mutex_unlock(&shared->lock);
+
+    return 0;
+}
+
+/**
+ * List one directory into the sink, and hand the listing to the cache
+ * when one is set (mtime < 0 skips that). Takes ownership of dir_fd.
+ * Returns 0 on success, -1 on allocation failure.
+ */
+static int scanner_list_dir(ScannerSink *sink, int dir_fd, long long mtime)
+{
+    DIR *dir = fdopendir(dir_fd);
+    if (!dir)
+    {
+        close(dir_fd);
+        return 0; // Unreadable directories are skipped
+    }
+
+    const ScannerCache *cache = mtime >= 0 ? sink->shared->cache : NULL;
+    ScannerFileInfo *files = NULL;
+    size_t file_count = 0;
+    size_t file_capacity = 0;
+    ScannerList subdirs = {NULL, 0, 0};
+
+    sink->dir_fd = dir_fd;
+
+    struct dirent *entry;
+    while (!sink->failed && (entry = readdir(dir)) != NULL)
+    {
+        const char *name = entry->d_name;
+        if (name[0] == '.')
+            continue;
+
+        int kind = scanner_entry_kind(dir_fd, entry);
+
+        if (kind == 1)
+        {
+            size_t before = sink->out->count;
+            if (scanner_sink_add_file(sink, name) != 0 || !cache || sink->out->count == before)
+                continue;
+
+            // Recording needs each kept file's size and mtime
+            struct stat st;
+            if (fstatat(dir_fd, name, &st, 0) != 0)
+                continue;
+
+            if (file_count >= file_capacity)
+            {
+                size_t new_capacity = file_capacity > 0 ? file_capacity * 2 : SCANNER_INITIAL_CAPACITY;
+                ScannerFileInfo *new_files = (ScannerFileInfo *)realloc(files, new_capacity * sizeof(ScannerFileInfo));
+                if (!new_files)
+                {
+                    sink->failed = 1;
+                    break;
+                }
+                files = new_files;
+                file_capacity = new_capacity;
+            }
+
+            // The name lives on in the result list until the scan ends
+            files[file_count].name = sink->out->items[sink->out->count - 1] + sink->name_start;
+            files[file_count].size = (long long)st.st_size;
+            files[file_count].mtime = scanner_mtime_ns(&st);
+            file_count++;
+        }
+        else if (kind == 2)
+        {
+            if (scanner_sink_add_subdir(sink, name) != 0 || !cache)
+                continue;
+
+            size_t len = strlen(name);
+            char *copy = (char *)malloc(len + 1);
+            if (!copy || scanner_list_push(&subdirs, copy) != 0)
+            {
+                free(copy);
+                sink->failed = 1;
+                break;
+            }
+            memcpy(copy, name, len + 1);
+        }
+    }
+
+    closedir(dir);
+    sink->dir_fd = -1;
+
+    if (cache && !sink->failed)
+    {
+        cache->store(cache->user_data, sink->path, mtime, files, file_count,
+                     (const char *const *)subdirs.items, subdirs.count);
+    }
+
+    free(files);
+    for (size_t i = 0; i < subdirs.count; i++)
+        free(subdirs.items[i]);
+    free(subdirs.items);
+
+    return sink->failed ? -1 : 0;
+}
+
+typedef struct
+{
+    ScannerShared *shared;
+    ScannerList found;
+} ScannerWorker;
+
+static void *scanner_worker_main(void *user_data)
+{
+    ScannerWorker *worker = (ScannerWorker *)user_data;
+    ScannerShared *shared = worker->shared;
+
+    pthread_mutex_lock(&shared->lock);
+    for (;;)
+    {
+        // Done once nothing is queued and nobody can queue more
+        while (shared->dir_count == 0 && shared->busy > 0 && !shared->failed)
+            pthread_cond_wait(&shared->cond, &shared->lock);
+
+        if (shared->dir_count == 0 || shared->failed)
+            break;
+
+        ScannerDir dir = shared->dirs[--shared->dir_count];
+        if (dir.fd >= 0)
+            shared->open_dirs--;
+        shared->busy++;
+        pthread_mutex_unlock(&shared->lock);
+
+        ScannerSink sink = {shared, &worker->found, dir.path, -1, 0, 0};
+        long long mtime = -1;
+        int cached = 0;
+
+        // An unchanged directory is replayed from the cache without listing it
+        if (shared->cache)
+        {
+            struct stat st;
+            if ((dir.fd >= 0 ? fstat(dir.fd, &st) : stat(dir.path, &st)) == 0)
+            {
+                mtime = scanner_mtime_ns(&st);
+                cached = shared->cache->lookup(shared->cache->user_data, dir.path, mtime, &sink);
+            }
+        }
+
+        int result = 0;
+        if (cached)
+        {
+            if (dir.fd >= 0)
+                close(dir.fd);
+            result = sink.failed ? -1 : 0;
+        }
+        else
+        {
+            int fd = dir.fd >= 0 ? dir.fd : open(dir.path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd >= 0)
+                result = scanner_list_dir(&sink, fd, mtime);
+        }
+        free(dir.path);
+
+        pthread_mutex_lock(&shared->lock);
+        shared->busy--;
+        if (result != 0)
+            shared->failed = 1;
+        pthread_cond_broadcast(&shared->cond);
+    }
+    pthread_mutex_unlock(&shared->lock);
+
+    return NULL;
+}
+
+/**
+ * Number of workers for a recursive scan (scan_threads setting)
+ */
+static int scanner_thread_count(void)
+{
+    long threads = config_get_long("scan_threads", SCANNER_DEFAULT_THREADS);
+    if (threads < 1)
+        threads = 1;
+    if (threads > SCANNER_MAX_THREADS)
+        threads = SCANNER_MAX_THREADS;
+    return (int)threads;
+}
+
+int scanner_scan(const char *folderpath, int recursive, ScannerFilter filter, const ScannerCache *cache, char ***out_paths)
+{
+    if (!folderpath || !out_paths)
+        return -1;
+
+    *out_paths = NULL;
+
+    int root_fd = open(folderpath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0)
+        return -1;
+
+    size_t root_len = strlen(folderpath);
+    char *root_path = (char *)malloc(root_len + 1);
+    if (!root_path)
+    {
+        close(root_fd);
+        return -1;
+    }
+    memcpy(root_path, folderpath, root_len + 1);
+
+    ScannerShared shared;
+    memset(&shared, 0, sizeof(shared));
+    shared.recursive = recursive;
+    shared.filter = filter;
+    shared.cache = cache;
+    pthread_mutex_init(&shared.lock, NULL);
+    pthread_cond_init(&shared.cond, NULL);
+
+    int thread_count = recursive ? scanner_thread_count() : 1;
+    ScannerWorker workers[SCANNER_MAX_THREADS];
+    pthread_t threads[SCANNER_MAX_THREADS];
+    int started = 0;
+
+    memset(workers, 0, sizeof(workers));
+    for (int i = 0; i < thread_count; i++)
+        workers[i].shared = &shared;
+
+    int failed = scanner_push_dir(&shared, root_path, root_fd) != 0;
+    if (failed)
+    {
+        close(root_fd);
+        free(root_path);
+    }
+    else
+    {
+        // The calling thread is worker 0; a flat scan needs no extra threads
+        for (int i = 1; i < thread_count; i++)
+        {
+            if (pthread_create(&threads[i], NULL, scanner_worker_main, &workers[i]) != 0)
+                break;
+            started = i;
+        }
+
+        scanner_worker_main(&workers[0]);
+
+        for (int i = 1; i <= started; i++)
+            pthread_join(threads[i], NULL);
+
+        failed = shared.failed;
+    }
+
+    // Whatever is left over after a failure still owns its path and fd
+    for (size_t i = 0; i < shared.dir_count; i++)
+    {
+        if (shared.dirs[i].fd >= 0)
+            close(shared.dirs[i].fd);
+        free(shared.dirs[i].path);
+    }
+    free(shared.dirs);
+    pthread_cond_destroy(&shared.cond);
+    pthread_mutex_destroy(&shared.lock);
+
+    // Concatenate the per-worker lists into worker 0's
+    ScannerList *all = &workers[0].found;
+    for (int i = 1; i < thread_count; i++)
+    {
+        ScannerList *list = &workers[i].found;
+        for (size_t j = 0; j < list->count; j++)
+        {
+            if (!failed && scanner_list_push(all, list->items[j]) != 0)
+                failed = 1;
+            if (failed)
+                free(list->items[j]);
+        }
+        free(list->items);
+    }
+
+    if (failed)
+    {
+        scanner_free(all->items, all->count);
+        return -1;
+    }
+
+    *out_paths = all->items;
+    return (int)all->count;
+}
+
+void scanner_free(char **paths, size_t count)
+{
+    if (!paths)
+        return;
+
+    for (size_t i = 0; i < count; i++)
+        free(paths[i]);
+    free(paths);
+}
@@ -0,0 +1,89 @@
+/**
+ * scanner.h - Directory scanner for folder playlists
+ *
+ * Collects the files below a folder that pass a name filter. Recursive
+ * scans walk subdirectories in parallel on a small worker pool.
+ */
+
+#ifndef WALCMAN_SCANNER_H
+#define WALCMAN_SCANNER_H
+
+#include <stddef.h>
+
+// Name filter: return 1 to keep a file, 0 to skip it
+typedef int (*ScannerFilter)(const char *name);
+
+// A file kept by the filter in a freshly listed directory
+typedef struct ScannerFileInfo
+{
+    const char *name; // File name (no directory part)
+    long long size;   // Size in bytes
+    long long mtime;  // Modification time in nanoseconds since the epoch
+} ScannerFileInfo;
+
+// Receives directory entries replayed by a cache, see scanner_sink_add_file()
+typedef struct ScannerSink ScannerSink;
+
+/**
+ * Directory listing cache (e.g. a persistent library index).
+ * Both callbacks may run concurrently on scanner worker threads.
+ */
+typedef struct ScannerCache
+{
+    void *user_data;
+
+    /**
+     * Replay a directory whose modification time is unchanged.
+     * Call scanner_sink_add_file()/scanner_sink_add_subdir() for every entry
+     * and return 1, or return 0 without adding anything to have it listed.
+     * mtime: Directory modification time in nanoseconds
+     */
+    int (*lookup)(void *user_data, const char *path, long long mtime, ScannerSink *sink);
+
+    /**
+     * Record a directory that was just listed.
+     * files: Kept files; subdirs: names of all subdirectories
+     */
+    void (*store)(void *user_data, const char *path, long long mtime,
+                  const ScannerFileInfo *files, size_t file_count,
+                  const char *const *subdirs, size_t subdir_count);
+} ScannerCache;
+
+/**
+ * Collect regular files in a folder (and optionally its subfolders).
+ * Hidden entries (leading '.') are skipped. Symlinks to files are kept;
+ * symlinks to directories are not followed, so loops cannot occur.
+ * folderpath: Folder to scan
+ * recursive: 1 to descend into subdirectories, 0 for the folder only
+ * filter: Name filter, or NULL to keep every file
+ * cache: Listing cache, or NULL to list every directory
+ * out_paths: Receives a malloc'd array of malloc'd full paths in no
+ *            particular order; release it with scanner_free()
+ * Returns: Number of paths found, or -1 on failure
+ */
+int scanner_scan(const char *folderpath, int recursive, ScannerFilter filter, const ScannerCache *cache, char ***out_paths);
+
+/**
+ * Add a cached file to the scan results (from ScannerCache.lookup)
+ * sink: Sink passed to lookup
+ * name: File name; the filter still applies
+ * Returns: 0 on success, -1 on allocation failure
+ */
+int scanner_sink_add_file(ScannerSink *sink, const char *name);
+
+/**
+ * Add a cached subdirectory, walked if the scan is recursive
+ * sink: Sink passed to lookup
+ * name: Subdirectory name
+ * Returns: 0 on success, -1 on allocation failure
+ */
+int scanner_sink_add_subdir(ScannerSink *sink, const char *name);
+
+/**
+ * Free a path array returned by scanner_scan()
+ * paths: Path array (may be NULL)
+ * count: Number of entries
+ */
+void scanner_free(char **paths, size_t count);
+
+#endif // WALCMAN_SCANNER_H
@@ -11,12 +11,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/ioctl.h>
 #include <termios.h>
 #include "terminal.h"
 
 // Store original terminal settings for restoration
 static struct termios original_termios;
 
+// Extra descriptor watched by terminal_read_line()
+static int read_hook_fd = -1;
+static void (*read_hook)(void *user_data) = NULL;
+static void *read_hook_data = NULL;
+
 void terminal_raw_mode(void)
 {
     if (tcgetattr(STDIN_FILENO, &original_termios) == -1)
@@ -70,7 +77,14 @@ int terminal_read_line(char *buffer, int max_len)
 
         if (ch == -1)
         {
-            usleep(10000); // Sleep a bit to avoid spinning
+            // Block until more input arrives instead of spinning
+            struct pollfd pfds[2] = {{STDIN_FILENO, POLLIN, 0}, {read_hook_fd, POLLIN, 0}};
+            int nfds = read_hook && read_hook_fd >= 0 ? 2 : 1;
+            if (poll(pfds, nfds, -1) < 0 || (pfds[0].revents & (POLLHUP | POLLERR | POLLNVAL)))
+                break;
+
+            if (nfds == 2 && (pfds[1].revents & POLLIN))
+                read_hook(read_hook_data);
             continue;
         }
 
@@ -108,4 +122,24 @@ int terminal_read_line(char *buffer, int max_len)
 
     buffer[pos] = '\0';
     return pos;
-}
\ No newline at end of file
+}
+
+int terminal_get_size(int *rows, int *cols)
+{
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_row == 0 || ws.ws_col == 0)
+        return -1;
+
+    if (rows)
+        *rows = ws.ws_row;
+    if (cols)
+        *cols = ws.ws_col;
+    return 0;
+}
+
+void terminal_set_read_hook(int fd, void (*on_ready)(void *user_data), void *user_data)
+{
+    read_hook_fd = fd;
+    read_hook = on_ready;
+    read_hook_data = user_data;
+}
@@ -39,4 +39,21 @@ int terminal_read_char(void);
  */
 int terminal_read_line(char *buffer, int max_len);
 
+/**
+ * Watch an extra descriptor while terminal_read_line() waits for input,
+ * so events (e.g. a track ending) are handled while a prompt is open
+ * fd: Descriptor to poll, or -1 to stop watching
+ * on_ready: Called on the reading thread whenever fd becomes readable
+ * user_data: Passed to on_ready
+ */
+void terminal_set_read_hook(int fd, void (*on_ready)(void *user_data), void *user_data);
+
+/**
+ * Get the terminal window size
+ * rows: Receives the number of rows
+ * cols: Receives the number of columns
+ * Returns: 0 on success, -1 if stdout is not a terminal
+ */
+int terminal_get_size(int *rows, int *cols);
+
 #endif // WALCMAN_TERMINAL_H
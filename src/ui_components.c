@@ -129,6 +129,35 @@ void ui_component_time_display(UIBuffer *buf, float current, float total)
     ui_buffer_appendf(buf, "%s / %s\n", current_str, total_str);
 }
 
+void ui_component_level_meter(UIBuffer *buf, const char *label, float level, int width)
+{
+    if (!buf)
+        return;
+
+    if (width <= 0)
+        width = DEFAULT_WIDTH;
+
+    char bar[128];
+    ui_format_progress_bar(bar, sizeof(bar), level, width);
+    ui_buffer_appendf(buf, "%s %s\n", label ? label : "", bar);
+}
+
+void ui_component_spectrum(UIBuffer *buf, const float *bands, int count)
+{
+    static const char *const blocks[] = {" ", "▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+
+    if (!buf || !bands)
+        return;
+
+    ui_buffer_append(buf, "  ");
+    for (int i = 0; i < count; i++)
+    {
+        float level = bands[i] < 0.0f ? 0.0f : (bands[i] > 1.0f ? 1.0f : bands[i]);
+        ui_buffer_append(buf, blocks[(int)(level * 8.0f + 0.5f)]);
+    }
+    ui_buffer_append(buf, "\n");
+}
+
 void ui_component_message(UIBuffer *buf, const char *message)
 {
     if (!buf)
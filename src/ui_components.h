@@ -90,6 +90,25 @@ void ui_component_progress_bar(UIBuffer *buf, float progress, int width);
  */
 void ui_component_time_display(UIBuffer *buf, float current, float total);
 
+// === Visualizer Components ===
+
+/**
+ * Render a labelled level bar
+ * buf: Buffer to append to
+ * label: Short label (e.g. "L")
+ * level: Level 0.0 to 1.0
+ * width: Width of the bar in characters
+ */
+void ui_component_level_meter(UIBuffer *buf, const char *label, float level, int width);
+
+/**
+ * Render spectrum bands as one row of block characters
+ * buf: Buffer to append to
+ * bands: Band levels 0.0 to 1.0
+ * count: Number of bands
+ */
+void ui_component_spectrum(UIBuffer *buf, const float *bands, int count);
+
 // === Message Components ===
 
 /**
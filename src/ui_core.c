@@ -6,6 +6,13 @@
  * ui_buffer_render() displays everything atomically to prevent flicker.
  *
  * Buffer growth strategy: doubles capacity when full.
+ *
+ * Rendering is differential: the previous frame is kept line by line and
+ * only lines that changed are rewritten in place, each followed by an
+ * erase-to-end-of-line. The whole frame goes out in a single write. A full
+ * redraw happens on the first frame, after ui_invalidate(), when the
+ * terminal size or UI color changes, and when the frame does not fit the
+ * window (lines would wrap or scroll, so row numbers stop matching).
  */
 
 #include <stdio.h>
@@ -14,9 +21,30 @@
 #include <stdarg.h>
 #include "ui_core.h"
 #include "ui_format.h"
+#include "terminal.h"
 
 #define INITIAL_BUFFER_SIZE 4096 // Start with 4KB buffer
 
+// One rendered frame, split into lines
+typedef struct UIFrame
+{
+    char *text;           // Copy of the rendered buffer
+    size_t size;
+    size_t capacity;
+    size_t *lines;        // Start offset of each line in text
+    size_t line_count;
+    size_t line_capacity;
+} UIFrame;
+
+// Previous and next frame; swapped after every render
+static UIFrame ui_frames[2];
+static int ui_shown;           // Index of the frame on screen
+static int ui_shown_valid;     // 0 forces the next frame to be drawn in full
+static int ui_shown_rows, ui_shown_cols;
+static char ui_shown_color[32];
+static UIBuffer *ui_output;    // Escape sequences and text for one frame
+static UIRenderStats ui_stats;
+
 UIBuffer *ui_buffer_create(void)
 {
     UIBuffer *buf = (UIBuffer *)malloc(sizeof(UIBuffer));
@@ -125,29 +153,218 @@ void ui_buffer_append_char(UIBuffer *buf, char c)
     buf->buffer[buf->size] = '\0';
 }
 
+/**
+ * Columns a line takes up: UTF-8 sequences count once, escape
+ * sequences not at all. Wide characters are counted as one column.
+ */
+static size_t ui_line_width(const char *line, size_t len)
+{
+    size_t width = 0;
+    size_t i = 0;
+
+    while (i < len)
+    {
+        unsigned char c = (unsigned char)line[i];
+        if (c == '\033' && i + 1 < len && line[i + 1] == '[')
+        {
+            // CSI: parameters until a final byte in 0x40-0x7E
+            i += 2;
+            while (i < len && ((unsigned char)line[i] < 0x40 || (unsigned char)line[i] > 0x7E))
+                i++;
+            i++;
+            continue;
+        }
+
+        if ((c & 0xC0) != 0x80)
+            width++;
+        i++;
+    }
+
+    return width;
+}
+
+/**
+ * Copy buffer contents into a frame and record where each line starts
+ * Returns: 0 on success, -1 on allocation failure
+ */
+static int ui_frame_load(UIFrame *frame, const UIBuffer *buf)
+{
+    if (buf->size + 1 > frame->capacity)
+    {
+        char *new_text = (char *)realloc(frame->text, buf->size + 1);
+        if (!new_text)
+            return -1;
+        frame->text = new_text;
+        frame->capacity = buf->size + 1;
+    }
+
+    memcpy(frame->text, buf->buffer, buf->size + 1);
+    frame->size = buf->size;
+
+    size_t count = 1;
+    for (size_t i = 0; i < buf->size; i++)
+    {
+        if (buf->buffer[i] == '\n')
+            count++;
+    }
+
+    if (count > frame->line_capacity)
+    {
+        size_t *new_lines = (size_t *)realloc(frame->lines, count * sizeof(size_t));
+        if (!new_lines)
+            return -1;
+        frame->lines = new_lines;
+        frame->line_capacity = count;
+    }
+
+    frame->line_count = 0;
+    frame->lines[frame->line_count++] = 0;
+    for (size_t i = 0; i < buf->size; i++)
+    {
+        if (buf->buffer[i] == '\n')
+            frame->lines[frame->line_count++] = i + 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Length of a frame line, without its newline
+ */
+static size_t ui_frame_line_length(const UIFrame *frame, size_t line)
+{
+    size_t end = line + 1 < frame->line_count ? frame->lines[line + 1] - 1 : frame->size;
+    return end - frame->lines[line];
+}
+
+/**
+ * Queue one line for output: optionally move to its row, rewrite it,
+ * then erase what is left of the old line
+ */
+static void ui_emit_line(const UIFrame *frame, size_t line, const char *color, int move)
+{
+    size_t len = ui_frame_line_length(frame, line);
+
+    if (move)
+        ui_buffer_appendf(ui_output, "\033[%zu;1H", line + 1);
+
+    ui_buffer_append(ui_output, color);
+
+    ui_buffer_grow(ui_output, len);
+    memcpy(ui_output->buffer + ui_output->size, frame->text + frame->lines[line], len);
+    ui_output->size += len;
+    ui_output->buffer[ui_output->size] = '\0';
+
+    ui_buffer_append(ui_output, "\033[K");
+}
+
 void ui_buffer_render(UIBuffer *buf)
 {
     if (!buf || !buf->buffer)
         return;
 
-    ui_clear_screen();
+    if (!ui_output)
+        ui_output = ui_buffer_create();
 
-    // Apply UI color from config
     const char *color = ui_get_color();
-    if (color && color[0] != '\0')
+    if (!color)
+        color = "";
+
+    UIFrame *old = &ui_frames[ui_shown];
+    UIFrame *frame = &ui_frames[!ui_shown];
+
+    if (!ui_output || ui_frame_load(frame, buf) != 0)
+    {
+        // Out of memory: draw the frame as-is and redraw fully next time
+        printf("\033[H\033[J%s%s%s", color, buf->buffer, color[0] != '\0' ? "\033[0m" : "");
+        fflush(stdout);
+        ui_shown_valid = 0;
+        return;
+    }
+
+    int rows = 0;
+    int cols = 0;
+    int sized = terminal_get_size(&rows, &cols) == 0;
+
+    int full = !ui_shown_valid || !sized ||
+               rows != ui_shown_rows || cols != ui_shown_cols ||
+               strcmp(color, ui_shown_color) != 0 ||
+               frame->line_count > (size_t)rows;
+
+    // Wrapped lines would push every following row down
+    for (size_t i = 0; i < frame->line_count && !full; i++)
     {
-        printf("%s", color);
+        if (ui_line_width(frame->text + frame->lines[i], ui_frame_line_length(frame, i)) >= (size_t)cols)
+            full = 1;
     }
 
-    printf("%s", buf->buffer);
+    ui_buffer_clear(ui_output);
+    if (full)
+        ui_buffer_append(ui_output, "\033[H");
 
-    // Reset color
-    if (color && color[0] != '\0')
+    for (size_t i = 0; i < frame->line_count; i++)
     {
-        printf("\033[0m");
+        int last = i + 1 == frame->line_count;
+
+        if (full)
+        {
+            ui_emit_line(frame, i, color, 0);
+            if (!last)
+                ui_buffer_append_char(ui_output, '\n');
+            continue;
+        }
+
+        // The last line is always rewritten so the cursor ends up after it
+        if (!last && i < old->line_count)
+        {
+            size_t len = ui_frame_line_length(frame, i);
+            if (len == ui_frame_line_length(old, i) &&
+                memcmp(frame->text + frame->lines[i], old->text + old->lines[i], len) == 0)
+            {
+                continue;
+            }
+        }
+
+        ui_emit_line(frame, i, color, 1);
     }
 
+    // Erase whatever the previous frame left below this one
+    if (full || old->line_count > frame->line_count)
+        ui_buffer_append(ui_output, "\033[J");
+
+    if (color[0] != '\0')
+        ui_buffer_append(ui_output, "\033[0m");
+
+    fwrite(ui_output->buffer, 1, ui_output->size, stdout);
     fflush(stdout);
+
+    ui_stats.frames++;
+    if (full)
+        ui_stats.full_frames++;
+    ui_stats.last_frame_bytes = ui_output->size;
+    ui_stats.bytes_written += ui_output->size;
+
+    // Clear-screen sequence, color, buffer and reset, as sent before diffing
+    ui_stats.bytes_full_redraw += 11 + buf->size + (color[0] != '\0' ? strlen(color) + 4 : 0);
+
+    ui_shown = !ui_shown;
+    ui_shown_valid = sized;
+    ui_shown_rows = rows;
+    ui_shown_cols = cols;
+    snprintf(ui_shown_color, sizeof(ui_shown_color), "%s", color);
+}
+
+void ui_invalidate(void)
+{
+    ui_shown_valid = 0;
+}
+
+void ui_get_render_stats(UIRenderStats *out)
+{
+    if (!out)
+        return;
+
+    *out = ui_stats;
 }
 
 void ui_clear_screen(void)
@@ -155,4 +372,5 @@ void ui_clear_screen(void)
     // Clear visible screen + scrollback, then move cursor home.
     printf("\033[2J\033[3J\033[H");
     fflush(stdout);
+    ui_invalidate();
 }
@@ -3,7 +3,8 @@
  *
  * Provides a buffer-based rendering system for atomic terminal updates.
  * UI components append to a UIBuffer, then ui_buffer_render() displays
- * everything at once, preventing flicker.
+ * everything at once, preventing flicker. Only lines that differ from the
+ * previous frame are sent to the terminal.
  *
  * Buffer automatically grows as needed to accommodate content.
  */
@@ -21,6 +22,16 @@ typedef struct UIBuffer
     size_t capacity; // Total allocated capacity
 } UIBuffer;
 
+// Renderer counters for the current session
+typedef struct UIRenderStats
+{
+    unsigned long frames;                 // Frames rendered
+    unsigned long full_frames;            // Frames drawn in full
+    size_t last_frame_bytes;              // Bytes written for the last frame
+    unsigned long long bytes_written;     // Bytes written for all frames
+    unsigned long long bytes_full_redraw; // Bytes clearing and reprinting every frame would take
+} UIRenderStats;
+
 /**
  * Create a new UI buffer with initial capacity
  * Returns: UIBuffer pointer on success, NULL on failure
@@ -62,11 +73,24 @@ void ui_buffer_appendf(UIBuffer *buf, const char *fmt, ...);
 void ui_buffer_append_char(UIBuffer *buf, char c);
 
 /**
- * Render buffer contents to terminal (atomic display)
+ * Render buffer contents to terminal (atomic display).
+ * Lines unchanged since the previous frame are left alone.
  * buf: Buffer to render
  */
 void ui_buffer_render(UIBuffer *buf);
 
+/**
+ * Make the next ui_buffer_render() redraw the whole screen.
+ * Call after writing to the terminal outside the renderer (prompts, errors).
+ */
+void ui_invalidate(void);
+
+/**
+ * Get renderer counters
+ * out: Receives the counters
+ */
+void ui_get_render_stats(UIRenderStats *out);
+
 /**
  * Clear terminal screen
  */
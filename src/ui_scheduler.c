@@ -0,0 +1,136 @@
+/**
+ * ui_scheduler.c - Frame scheduling for live screens implementation
+ *
+ * The display state is (whole seconds shown, filled bar cells). Both are
+ * step functions of the playback position, so the next change is the
+ * nearer of the next second and the next cell boundary. Sleeping until
+ * then gives a bar that moves as soon as it can, while a long track at a
+ * narrow bar width still only costs about one frame per second.
+ */
+
+#include <math.h>
+#include "ui_scheduler.h"
+#include "util.h"
+
+#define UI_SCHEDULER_MAX_SLEEP_MS 1000 // Re-check at least once a second
+
+/**
+ * Filled progress bar cells for a position, matching ui_format_progress_bar()
+ */
+static int ui_scheduler_cells(const UIScheduler *sched, float position, float duration)
+{
+    if (duration <= 0.0f)
+        return 0;
+
+    float progress = position / duration;
+    if (progress < 0.0f)
+        progress = 0.0f;
+    if (progress > 1.0f)
+        progress = 1.0f;
+
+    return (int)(progress * sched->bar_width);
+}
+
+void ui_scheduler_init(UIScheduler *sched, int refresh_hz, int bar_width)
+{
+    if (!sched)
+        return;
+
+    sched->min_interval_ms = refresh_hz > 0 ? 1000 / refresh_hz : 0;
+    if (refresh_hz > 0 && sched->min_interval_ms == 0)
+        sched->min_interval_ms = 1;
+    sched->bar_width = bar_width > 0 ? bar_width : 1;
+    sched->shown_second = -1;
+    sched->shown_cells = -1;
+    sched->continuous = 0;
+    sched->frame_start = 0.0;
+    sched->stats = (UISchedulerStats){0};
+}
+
+int ui_scheduler_timeout(const UIScheduler *sched, float position, float duration, int live)
+{
+    if (!sched || !live || sched->min_interval_ms == 0)
+        return -1;
+
+    if (sched->continuous)
+        return sched->min_interval_ms;
+
+    if (position < 0.0f)
+        position = 0.0f;
+
+    // Next whole second shown by the time display
+    double next_change = floor(position) + 1.0;
+
+    // Next progress bar cell boundary
+    if (duration > 0.0f && position < duration)
+    {
+        double cell = (double)duration / sched->bar_width;
+        double next_cell = (ui_scheduler_cells(sched, position, duration) + 1) * cell;
+        if (next_cell < next_change)
+            next_change = next_cell;
+    }
+
+    // Round up and add a millisecond so the wakeup lands past the boundary
+    int timeout = (int)ceil((next_change - position) * 1000.0) + 1;
+    if (timeout < sched->min_interval_ms)
+        timeout = sched->min_interval_ms;
+    if (timeout > UI_SCHEDULER_MAX_SLEEP_MS)
+        timeout = UI_SCHEDULER_MAX_SLEEP_MS;
+
+    return timeout;
+}
+
+int ui_scheduler_begin_frame(UIScheduler *sched, float position, float duration)
+{
+    if (!sched)
+        return 0;
+
+    sched->stats.wakeups++;
+
+    long second = position > 0.0f ? (long)position : 0;
+    int cells = ui_scheduler_cells(sched, position, duration);
+    if (!sched->continuous && second == sched->shown_second && cells == sched->shown_cells)
+    {
+        sched->stats.skipped++;
+        return 0;
+    }
+
+    sched->shown_second = second;
+    sched->shown_cells = cells;
+    sched->frame_start = util_time_ms();
+    return 1;
+}
+
+void ui_scheduler_set_continuous(UIScheduler *sched, int continuous)
+{
+    if (!sched)
+        return;
+
+    sched->continuous = continuous ? 1 : 0;
+}
+
+void ui_scheduler_end_frame(UIScheduler *sched)
+{
+    if (!sched)
+        return;
+
+    double elapsed = util_time_ms() - sched->frame_start;
+    sched->stats.frames++;
+    sched->stats.frame_ms_total += elapsed;
+    if (elapsed > sched->stats.frame_ms_max)
+        sched->stats.frame_ms_max = elapsed;
+}
+
+void ui_scheduler_get_stats(const UIScheduler *sched, UISchedulerStats *out)
+{
+    if (!out)
+        return;
+
+    if (!sched)
+    {
+        *out = (UISchedulerStats){0};
+        return;
+    }
+
+    *out = sched->stats;
+}
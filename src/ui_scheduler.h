@@ -0,0 +1,86 @@
+/**
+ * ui_scheduler.h - Frame scheduling for live screens
+ *
+ * Keeps the progress bar and time display moving while a track plays
+ * without redrawing on a fixed tick. The scheduler works out when the
+ * displayed second or the filled part of the bar next changes, lets the
+ * main loop sleep until then (never waking more often than the configured
+ * refresh rate), and only asks for a frame when the display really differs.
+ *
+ * Screens that animate on their own (the visualizer) switch it to
+ * continuous mode, where every wakeup at the refresh rate draws a frame.
+ */
+
+#ifndef WALCMAN_UI_SCHEDULER_H
+#define WALCMAN_UI_SCHEDULER_H
+
+// Frame counters for the current session
+typedef struct UISchedulerStats
+{
+    unsigned long wakeups;  // Timed wakeups for live refresh
+    unsigned long frames;   // Frames drawn by the scheduler
+    unsigned long skipped;  // Wakeups where the display had not changed
+    double frame_ms_total;  // Time spent building and rendering frames
+    double frame_ms_max;    // Slowest frame
+} UISchedulerStats;
+
+typedef struct UIScheduler
+{
+    int min_interval_ms; // Shortest time between frames, 0 if live refresh is off
+    int bar_width;       // Progress bar cells
+    long shown_second;   // Displayed position, -1 if nothing shown yet
+    int shown_cells;     // Filled bar cells displayed
+    int continuous;      // 1 to draw at the refresh rate regardless of progress
+    double frame_start;  // Start of the frame being drawn
+    UISchedulerStats stats;
+} UIScheduler;
+
+/**
+ * Set up a scheduler
+ * sched: Scheduler to initialize
+ * refresh_hz: Maximum live refresh rate, 0 to disable live refresh
+ * bar_width: Progress bar width in cells (as drawn by the screens)
+ */
+void ui_scheduler_init(UIScheduler *sched, int refresh_hz, int bar_width);
+
+/**
+ * Get how long the main loop may sleep before the display changes
+ * sched: Scheduler
+ * position: Playback position in seconds
+ * duration: Track length in seconds (0 if unknown)
+ * live: 1 if a live screen is showing a playing track
+ * Returns: Timeout in milliseconds for poll(), or -1 to wait for input
+ */
+int ui_scheduler_timeout(const UIScheduler *sched, float position, float duration, int live);
+
+/**
+ * Switch continuous refresh on or off
+ * sched: Scheduler
+ * continuous: 1 to draw every min_interval while live, 0 to follow progress only
+ */
+void ui_scheduler_set_continuous(UIScheduler *sched, int continuous);
+
+/**
+ * Check whether the progress display differs from the last frame.
+ * When it does, the new state is recorded and frame timing starts.
+ * sched: Scheduler
+ * position: Playback position in seconds
+ * duration: Track length in seconds (0 if unknown)
+ * Returns: 1 if a frame should be drawn, 0 otherwise
+ */
+int ui_scheduler_begin_frame(UIScheduler *sched, float position, float duration);
+
+/**
+ * Finish a frame started by ui_scheduler_begin_frame()
+ * sched: Scheduler
+ */
+void ui_scheduler_end_frame(UIScheduler *sched);
+
+/**
+ * Get frame counters
+ * sched: Scheduler
+ * out: Receives the counters
+ */
+void ui_scheduler_get_stats(const UIScheduler *sched, UISchedulerStats *out);
+
+#endif // WALCMAN_UI_SCHEDULER_H
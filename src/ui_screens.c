@@ -14,6 +14,12 @@
 #include "ui_components.h"
 #include "ui_format.h"
 #include "player.h"
+#include "terminal.h"
+
+#define QUEUE_VIEW_MIN_ROWS 3 // Queue items listed even on tiny terminals
+
+// Visualizer drawn on the playing screen, NULL if none
+static const Visualizer *screen_visualizer = NULL;
 
 // ===== Command definitions =====
 
@@ -86,6 +92,7 @@ static void display_commands(UIBuffer *buf, const char *title, int show_play_fil
         ui_component_key_hint(buf, "[space]", "Play/Pause");
         ui_component_key_hint(buf, "[b]", "Previous track");
         ui_component_key_hint(buf, "[n]", "Next track");
+        ui_component_key_hint(buf, "[,/.]", "Seek -/+10s");
         ui_component_key_hint(buf, "[f]", "Toggle shuffle");
     }
 
@@ -96,6 +103,54 @@ static void display_commands(UIBuffer *buf, const char *title, int show_play_fil
     }
 }
 
+/**
+ * Display progress bar and time for a loaded track
+ * buf: Buffer to append to
+ * player: Player to read position from
+ */
+static void display_progress(UIBuffer *buf, Player *player)
+{
+    PlayerState state = player_get_state(player);
+    if (state != STATE_PLAYING && state != STATE_PAUSED)
+        return;
+
+    float position = player_get_position(player);
+    float duration = player_get_duration(player);
+
+    ui_component_progress_bar(buf, duration > 0.0f ? position / duration : 0.0f, UI_PROGRESS_BAR_WIDTH);
+    ui_component_time_display(buf, position, duration);
+}
+
+/**
+ * Display level bars and spectrum, if a visualizer is set
+ * buf: Buffer to append to
+ */
+static void display_visualizer(UIBuffer *buf)
+{
+    static const char *const labels[PLAYER_METER_CHANNELS] = {"L", "R"};
+    const Visualizer *vis = screen_visualizer;
+
+    if (!vis || !vis->enabled)
+        return;
+
+    ui_buffer_append(buf, "\n");
+    if (vis->channels == 1)
+    {
+        ui_component_level_meter(buf, "M", vis->levels[0], UI_PROGRESS_BAR_WIDTH);
+    }
+    else
+    {
+        for (int c = 0; c < PLAYER_METER_CHANNELS; c++)
+            ui_component_level_meter(buf, labels[c], vis->levels[c], UI_PROGRESS_BAR_WIDTH);
+    }
+    ui_component_spectrum(buf, vis->bands, VISUALIZER_BANDS);
+}
+
+void ui_screens_set_visualizer(const Visualizer *vis)
+{
+    screen_visualizer = vis;
+}
+
 void ui_screen_welcome(UIBuffer *buf, int show_controls, const char *repeat_symbol, const char *shuffle_symbol, const char *repeat_label)
 {
     if (!buf)
@@ -147,13 +202,17 @@ void ui_screen_playing(UIBuffer *buf, Player *player, int show_controls, const c
 
     PlayerState state = player_get_state(player);
 
-    if (state == STATE_PLAYING || state == STATE_PAUSED)
+    if (state == STATE_PLAYING || state == STATE_PAUSED || state == STATE_LOADING)
     {
         // Show playback status
         if (state == STATE_PAUSED)
         {
             ui_component_status_line(buf, "⏸", "PAUSED");
         }
+        else if (state == STATE_LOADING)
+        {
+            ui_component_status_line(buf, "…", "LOADING");
+        }
         else
         {
             ui_component_status_line(buf, "▶", "PLAYING");
@@ -173,6 +232,9 @@ void ui_screen_playing(UIBuffer *buf, Player *player, int show_controls, const c
         ui_buffer_append(buf, " ");
         ui_buffer_append(buf, loop_indicator);
         ui_buffer_append(buf, "\n");
+        display_progress(buf, player);
+        if (state != STATE_LOADING)
+            display_visualizer(buf);
         ui_buffer_append(buf, "\n");
 
         // Show controls (context: already playing, so show stop + pause)
@@ -279,7 +341,73 @@ void ui_screen_color_picker(UIBuffer *buf, const char *selected_color)
     screen_end(buf);
 }
 
-void ui_screen_queue(UIBuffer *buf, const Queue *queue, const char *repeat_symbol, const char *repeat_label)
+void ui_queue_view_init(UIQueueView *view)
+{
+    if (!view)
+        return;
+
+    view->top = 0;
+    view->rows = 0;
+    view->follow = 1;
+    view->last_current = -1;
+}
+
+void ui_queue_view_scroll(UIQueueView *view, long delta)
+{
+    if (!view)
+        return;
+
+    // Clamped against the queue length on the next build
+    if (delta < 0 && (size_t)(-delta) > view->top)
+        view->top = 0;
+    else
+        view->top += delta;
+
+    view->follow = 0;
+}
+
+void ui_queue_view_follow(UIQueueView *view)
+{
+    if (view)
+        view->follow = 1;
+}
+
+/**
+ * Count newlines in part of a buffer
+ * buf: Buffer to scan
+ * from: Offset to start at
+ */
+static size_t count_lines(const UIBuffer *buf, size_t from)
+{
+    size_t lines = 0;
+    for (size_t i = from; i < buf->size; i++)
+    {
+        if (buf->buffer[i] == '\n')
+            lines++;
+    }
+    return lines;
+}
+
+/**
+ * Build the queue screen's key hints and footer
+ * buf: Buffer to append to
+ */
+static void queue_screen_end(UIBuffer *buf)
+{
+    ui_buffer_append(buf, "\n");
+    ui_component_key_hints_section(buf, "Queue");
+    ui_component_key_hint(buf, "[b]", "Previous track");
+    ui_component_key_hint(buf, "[n]", "Next track");
+    ui_component_key_hint(buf, "[r]", "Cycle repeat mode");
+    ui_component_key_hint(buf, "[f]", "Toggle shuffle");
+    ui_component_key_hint(buf, "[a]", "Add file to queue");
+    ui_component_key_hint(buf, "[j/k]", "Scroll (d/u page, g current)");
+    ui_component_key_hints_section(buf, "Navigation");
+    ui_component_key_hint(buf, "[q]", "Back");
+    screen_end(buf);
+}
+
+void ui_screen_queue(UIBuffer *buf, const Queue *queue, Player *player, UIQueueView *view, const char *repeat_symbol, const char *repeat_label)
 {
     if (!buf)
         return;
@@ -307,10 +435,68 @@ void ui_screen_queue(UIBuffer *buf, const Queue *queue, const char *repeat_symbo
     size_t count = queue_count(queue);
 
     ui_buffer_appendf(buf, "Tracks: %zu\n", count);
+    if (player)
+        display_progress(buf, player);
     ui_buffer_append(buf, "\n");
 
-    for (size_t i = 0; i < count; i++)
+    // Measure the hints below the list by building them once and
+    // dropping them again, so the list gets exactly the rows that are left
+    size_t list_start = buf->size;
+    queue_screen_end(buf);
+    size_t footer_lines = count_lines(buf, list_start);
+    buf->size = list_start;
+    buf->buffer[buf->size] = '\0';
+
+    int term_rows = 0;
+    if (terminal_get_size(&term_rows, NULL) != 0)
+        term_rows = 24;
+
+    // Leave the last row free so the frame never scrolls the terminal
+    long available = (long)term_rows - (long)count_lines(buf, 0) - (long)footer_lines - 1;
+    size_t rows = available > QUEUE_VIEW_MIN_ROWS ? (size_t)available : QUEUE_VIEW_MIN_ROWS;
+
+    if (rows > count)
+        rows = count;
+
+    UIQueueView fallback;
+    if (!view)
     {
+        ui_queue_view_init(&fallback);
+        view = &fallback;
+    }
+
+    // A new track brings the view back to it
+    if (current != view->last_current)
+    {
+        view->follow = 1;
+        view->last_current = current;
+    }
+
+    size_t top = view->top;
+    if (view->follow && current >= 0)
+        top = (size_t)current > rows / 2 ? (size_t)current - rows / 2 : 0;
+    if (top > count - rows)
+        top = count - rows;
+
+    view->top = top;
+    view->rows = rows;
+
+    // The first and last rows turn into "more" markers when items are hidden
+    size_t end = top + rows;
+    for (size_t i = top; i < end; i++)
+    {
+        if (i == top && top > 0)
+        {
+            ui_buffer_appendf(buf, "   ... %zu more above\n", top + 1);
+            continue;
+        }
+
+        if (i + 1 == end && end < count)
+        {
+            ui_buffer_appendf(buf, "   ... %zu more below\n", count - end + 1);
+            continue;
+        }
+
         const char *item = queue_get_item(queue, i);
         char formatted_name[64];
         ui_format_filename(formatted_name, sizeof(formatted_name), item, 40);
@@ -325,14 +511,5 @@ void ui_screen_queue(UIBuffer *buf, const Queue *queue, const char *repeat_symbo
         }
     }
 
-    ui_buffer_append(buf, "\n");
-    ui_component_key_hints_section(buf, "Queue");
-    ui_component_key_hint(buf, "[b]", "Previous track");
-    ui_component_key_hint(buf, "[n]", "Next track");
-    ui_component_key_hint(buf, "[r]", "Cycle repeat mode");
-    ui_component_key_hint(buf, "[f]", "Toggle shuffle");
-    ui_component_key_hint(buf, "[a]", "Add file to queue");
-    ui_component_key_hints_section(buf, "Navigation");
-    ui_component_key_hint(buf, "[q]", "Back");
-    screen_end(buf);
+    queue_screen_end(buf);
 }
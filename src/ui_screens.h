@@ -5,7 +5,7 @@
  * Each function builds a complete screen in the provided buffer:
  * - ui_screen_welcome(): Initial screen with key hints
  * - ui_screen_help(): Detailed help and controls
- * - ui_screen_playing(): Now playing screen with status
+ * - ui_screen_playing(): Now playing screen with status, progress and visualizer
  * - ui_screen_loading(): Loading indicator for file loads
  */
 
@@ -15,6 +15,19 @@
 #include "ui_core.h"
 #include "player.h"
 #include "queue.h"
+#include "visualizer.h"
+
+// Progress bar width on the playing and queue screens, in cells
+#define UI_PROGRESS_BAR_WIDTH 30
+
+// Scroll state of the queue screen, which lists only the rows that fit
+typedef struct UIQueueView
+{
+    size_t top;          // First listed item
+    size_t rows;         // Items listed by the last build
+    int follow;          // 1 to keep the current track centered
+    int last_current;    // Current index at the last build
+} UIQueueView;
 
 /**
  * Build welcome screen (shown on startup)
@@ -32,6 +45,12 @@ void ui_screen_welcome(UIBuffer *buf, int show_controls, const char *repeat_symb
  */
 void ui_screen_help(UIBuffer *buf);
 
+/**
+ * Show a visualizer's bars on the playing screen
+ * vis: Visualizer to draw from, or NULL for none
+ */
+void ui_screens_set_visualizer(const Visualizer *vis);
+
 /**
  * Build now-playing screen with status
  * buf: Buffer to build screen into
@@ -66,9 +85,31 @@ void ui_screen_color_picker(UIBuffer *buf, const char *selected_color);
  * Build queue view screen
  * buf: Buffer to build screen into
  * queue: Queue state to display
+ * player: Player to show progress from (may be NULL)
+ * view: Scroll state; only the items that fit the terminal are listed
  * repeat_symbol: Compact repeat symbol
  * repeat_label: Current repeat mode label
  */
-void ui_screen_queue(UIBuffer *buf, const Queue *queue, const char *repeat_symbol, const char *repeat_label);
+void ui_screen_queue(UIBuffer *buf, const Queue *queue, Player *player, UIQueueView *view, const char *repeat_symbol, const char *repeat_label);
+
+/**
+ * Reset queue view scroll state (centered on the current track)
+ * view: View to reset
+ */
+void ui_queue_view_init(UIQueueView *view);
+
+/**
+ * Scroll the queue view; it stops following the current track until
+ * the track changes or ui_queue_view_follow() is called
+ * view: View to scroll
+ * delta: Items to move by (negative scrolls up)
+ */
+void ui_queue_view_scroll(UIQueueView *view, long delta);
+
+/**
+ * Scroll the queue view back to the current track and keep it centered
+ * view: View to update
+ */
+void ui_queue_view_follow(UIQueueView *view);
 
 #endif // WALCMAN_UI_SCREENS_H
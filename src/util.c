@@ -5,6 +5,8 @@
  */
 
 #include <string.h>
+#include <time.h>
+#include <sys/resource.h>
 #include "util.h"
 
 void strip_quotes(char *str)
@@ -46,3 +48,23 @@ void unescape_path(char *str)
     }
     *dst = '\0'; // Null terminate
 }
+
+long util_peak_memory_kb(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+#ifdef __APPLE__
+    return (long)(usage.ru_maxrss / 1024); // macOS reports bytes
+#else
+    return (long)usage.ru_maxrss; // Linux reports kilobytes
+#endif
+}
+
+double util_time_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
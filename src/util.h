@@ -21,4 +21,16 @@ void strip_quotes(char *str);
  */
 void unescape_path(char *str);
 
+/**
+ * Get the peak resident set size of this process
+ * Returns: Peak memory in kilobytes, or 0 if unavailable
+ */
+long util_peak_memory_kb(void);
+
+/**
+ * Get a monotonic timestamp for measuring intervals
+ * Returns: Milliseconds since an arbitrary fixed point
+ */
+double util_time_ms(void);
+
 #endif // WALCMAN_UTIL_H
@@ -0,0 +1,317 @@
+/**
+ * visualizer.c - Level meter and spectrum implementation
+ *
+ * The FFT is the usual trick for real input: the N samples are packed
+ * into N/2 complex values, transformed with an iterative radix-2 FFT and
+ * split back into the N/2 + 1 bins of the real transform. Data and
+ * twiddles are kept as separate real/imaginary arrays, and each stage's
+ * twiddles are stored contiguously, so the inner butterfly loop walks
+ * memory linearly and the compiler can vectorize it.
+ *
+ * Bars fall back gradually instead of jumping down, so a frame rate of
+ * 10-20 Hz still looks smooth.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "visualizer.h"
+#include "util.h"
+
+#define VISUALIZER_PI 3.14159265358979323846
+#define VISUALIZER_LOW_HZ 40.0    // Lower edge of the first band
+#define VISUALIZER_HIGH_HZ 16000.0 // Upper edge of the last band (capped at Nyquist)
+#define VISUALIZER_SPECTRUM_DB 60.0f // Range from empty to full band
+#define VISUALIZER_LEVEL_DB 48.0f    // Range from empty to full level bar
+#define VISUALIZER_FALL_SECONDS 0.6f // Time for a full bar to drop to nothing
+
+/**
+ * Rebuild window and twiddle tables for the current fft_size
+ */
+static void visualizer_build_tables(Visualizer *vis)
+{
+    size_t n = vis->fft_size;
+    size_t half = n / 2;
+
+    for (size_t i = 0; i < n; i++)
+        vis->window[i] = (float)(0.5 - 0.5 * cos(2.0 * VISUALIZER_PI * i / (n - 1)));
+
+    // Stage with span 2h uses exp(-i*pi*j/h) for j < h, stored at h - 1 + j
+    for (size_t h = 1; h < half; h *= 2)
+    {
+        for (size_t j = 0; j < h; j++)
+        {
+            double angle = -VISUALIZER_PI * j / h;
+            vis->stage_cos[h - 1 + j] = (float)cos(angle);
+            vis->stage_sin[h - 1 + j] = (float)sin(angle);
+        }
+    }
+
+    for (size_t k = 0; k < half; k++)
+    {
+        double angle = -2.0 * VISUALIZER_PI * k / n;
+        vis->post_cos[k] = (float)cos(angle);
+        vis->post_sin[k] = (float)sin(angle);
+    }
+
+    vis->cost_ms = 0.0;
+}
+
+/**
+ * In-place complex FFT of vis->re/vis->im (fft_size / 2 points)
+ */
+static void visualizer_fft(Visualizer *vis)
+{
+    size_t m = vis->fft_size / 2;
+    float *re = vis->re;
+    float *im = vis->im;
+
+    // Bit-reversal permutation
+    for (size_t i = 1, j = 0; i < m; i++)
+    {
+        size_t bit = m >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+
+        if (i < j)
+        {
+            float t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for (size_t h = 1; h < m; h *= 2)
+    {
+        const float *wr = vis->stage_cos + h - 1;
+        const float *wi = vis->stage_sin + h - 1;
+
+        for (size_t start = 0; start < m; start += 2 * h)
+        {
+            float *ar = re + start;
+            float *ai = im + start;
+            float *br = ar + h;
+            float *bi = ai + h;
+
+            for (size_t j = 0; j < h; j++)
+            {
+                float tr = br[j] * wr[j] - bi[j] * wi[j];
+                float ti = br[j] * wi[j] + bi[j] * wr[j];
+                br[j] = ar[j] - tr;
+                bi[j] = ai[j] - ti;
+                ar[j] += tr;
+                ai[j] += ti;
+            }
+        }
+    }
+}
+
+/**
+ * Magnitude of bin k (0..fft_size/2) of the real transform, after
+ * visualizer_fft() ran on the packed samples
+ */
+static float visualizer_bin(const Visualizer *vis, size_t k)
+{
+    size_t m = vis->fft_size / 2;
+
+    if (k == 0 || k == m)
+    {
+        // DC and Nyquist: the sum and difference of the packed halves
+        float value = k == 0 ? vis->re[0] + vis->im[0] : vis->re[0] - vis->im[0];
+        return fabsf(value);
+    }
+
+    // Even/odd parts from Z[k] and conj(Z[m - k])
+    float zr = vis->re[k], zi = vis->im[k];
+    float cr = vis->re[m - k], ci = -vis->im[m - k];
+    float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+    float dr = 0.5f * (zr - cr), di = 0.5f * (zi - ci);
+
+    // X[k] = E + w^k * D / i
+    float or_ = di, oi = -dr;
+    float xr = er + vis->post_cos[k] * or_ - vis->post_sin[k] * oi;
+    float xi = ei + vis->post_cos[k] * oi + vis->post_sin[k] * or_;
+    return sqrtf(xr * xr + xi * xi);
+}
+
+/**
+ * Map a level in dB to 0..1 over range dB below full scale
+ */
+static float visualizer_scale(float amplitude, float range)
+{
+    if (amplitude <= 0.0f)
+        return 0.0f;
+
+    float level = (20.0f * log10f(amplitude) + range) / range;
+    if (level < 0.0f)
+        return 0.0f;
+    if (level > 1.0f)
+        return 1.0f;
+    return level;
+}
+
+/**
+ * Move a shown bar towards target: up at once, down at fall_step per frame
+ */
+static float visualizer_settle(const Visualizer *vis, float shown, float target)
+{
+    if (target >= shown)
+        return target;
+
+    shown -= vis->fall_step;
+    return shown > target ? shown : target;
+}
+
+/**
+ * Recompute the spectrum bands from the sample history
+ */
+static void visualizer_spectrum(Visualizer *vis)
+{
+    size_t n = vis->fft_size;
+    size_t m = n / 2;
+    const float *samples = vis->history + (VISUALIZER_FFT_MAX - n);
+
+    for (size_t i = 0; i < m; i++)
+    {
+        vis->re[i] = samples[2 * i] * vis->window[2 * i];
+        vis->im[i] = samples[2 * i + 1] * vis->window[2 * i + 1];
+    }
+
+    visualizer_fft(vis);
+
+    double nyquist = vis->sample_rate / 2.0;
+    double high = VISUALIZER_HIGH_HZ < nyquist ? VISUALIZER_HIGH_HZ : nyquist;
+    double bin_hz = (double)vis->sample_rate / n;
+    double ratio = pow(high / VISUALIZER_LOW_HZ, 1.0 / VISUALIZER_BANDS);
+
+    // A full-scale sine through the Hann window peaks at n / 4
+    float normalize = 4.0f / n;
+    double low = VISUALIZER_LOW_HZ;
+
+    for (int b = 0; b < VISUALIZER_BANDS; b++)
+    {
+        double top = low * ratio;
+        size_t first = (size_t)(low / bin_hz + 0.5);
+        size_t last = (size_t)(top / bin_hz + 0.5);
+        if (last > m)
+            last = m;
+        if (first > last)
+            first = last;
+
+        float peak = 0.0f;
+        for (size_t k = first; k <= last; k++)
+        {
+            float magnitude = visualizer_bin(vis, k);
+            if (magnitude > peak)
+                peak = magnitude;
+        }
+
+        float target = visualizer_scale(peak * normalize, VISUALIZER_SPECTRUM_DB);
+        vis->bands[b] = visualizer_settle(vis, vis->bands[b], target);
+        low = top;
+    }
+}
+
+void visualizer_init(Visualizer *vis, int enabled, int frame_hz, double cpu_percent)
+{
+    if (!vis)
+        return;
+
+    memset(vis, 0, sizeof(*vis));
+    vis->enabled = enabled ? 1 : 0;
+
+    if (frame_hz <= 0)
+        frame_hz = 10;
+    vis->budget_ms = cpu_percent * 10.0 / frame_hz; // percent of 1000 ms, split over the frames
+    vis->fall_step = 1.0f / (VISUALIZER_FALL_SECONDS * frame_hz);
+
+    vis->fft_size = VISUALIZER_FFT_MAX;
+    visualizer_build_tables(vis);
+}
+
+void visualizer_set_active(Visualizer *vis, Player *player, int active)
+{
+    if (!vis || !player)
+        return;
+
+    active = active && vis->enabled;
+    if (active == vis->active)
+        return;
+
+    vis->active = active;
+    player_set_visual_tap(player, active);
+
+    // Start from fresh samples and empty bars either way
+    player_read_visual_samples(player, vis->history, VISUALIZER_FFT_MAX);
+    memset(vis->history, 0, sizeof(vis->history));
+    memset(vis->bands, 0, sizeof(vis->bands));
+    memset(vis->levels, 0, sizeof(vis->levels));
+    vis->history_fill = 0;
+}
+
+void visualizer_update(Visualizer *vis, Player *player)
+{
+    if (!vis || !player || !vis->active)
+        return;
+
+    double start = util_time_ms();
+
+    // Append new samples, keeping the newest VISUALIZER_FFT_MAX
+    float fresh[VISUALIZER_FFT_MAX];
+    size_t count = player_read_visual_samples(player, fresh, VISUALIZER_FFT_MAX);
+    if (count > 0)
+    {
+        size_t keep = VISUALIZER_FFT_MAX - count;
+        memmove(vis->history, vis->history + count, keep * sizeof(float));
+        memcpy(vis->history + keep, fresh, count * sizeof(float));
+        vis->history_fill += count;
+        if (vis->history_fill > VISUALIZER_FFT_MAX)
+            vis->history_fill = VISUALIZER_FFT_MAX;
+    }
+
+    PlayerTelemetry telemetry;
+    player_get_telemetry(player, &telemetry);
+    vis->channels = telemetry.channels;
+    for (unsigned int c = 0; c < telemetry.channels; c++)
+    {
+        float target = visualizer_scale(telemetry.peak[c], VISUALIZER_LEVEL_DB);
+        vis->levels[c] = visualizer_settle(vis, vis->levels[c], target);
+    }
+
+    vis->sample_rate = player_get_output_rate(player);
+    if (vis->sample_rate == 0 || vis->history_fill < vis->fft_size)
+        return;
+
+    visualizer_spectrum(vis);
+
+    double elapsed = util_time_ms() - start;
+    vis->stats.frames++;
+    vis->stats.ms_total += elapsed;
+    if (elapsed > vis->stats.ms_max)
+        vis->stats.ms_max = elapsed;
+
+    // Stay inside the CPU budget by trading frequency resolution
+    vis->cost_ms = vis->cost_ms == 0.0 ? elapsed : vis->cost_ms * 0.9 + elapsed * 0.1;
+    if (vis->cost_ms > vis->budget_ms && vis->fft_size > VISUALIZER_FFT_MIN)
+    {
+        vis->fft_size /= 2;
+        visualizer_build_tables(vis);
+    }
+}
+
+void visualizer_get_stats(const Visualizer *vis, VisualizerStats *out)
+{
+    if (!out)
+        return;
+
+    if (!vis)
+    {
+        *out = (VisualizerStats){0};
+        return;
+    }
+
+    *out = vis->stats;
+}
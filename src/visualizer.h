@@ -0,0 +1,84 @@
+/**
+ * visualizer.h - Level meter and spectrum for the playing screen
+ *
+ * Pulls the newest output samples from the player's visualizer tap once
+ * per UI frame, runs a real FFT over them and folds the result into a few
+ * log-spaced bands. Level bars come from the audio thread telemetry.
+ * Nothing runs while the visualizer is inactive, and the FFT shrinks if a
+ * frame costs more than the configured CPU budget.
+ */
+
+#ifndef WALCMAN_VISUALIZER_H
+#define WALCMAN_VISUALIZER_H
+
+#include "player.h"
+
+#define VISUALIZER_FFT_MAX 1024 // Largest (and initial) FFT size
+#define VISUALIZER_FFT_MIN 256  // The budget never shrinks the FFT below this
+#define VISUALIZER_BANDS 24     // Spectrum bands shown
+
+// Cost counters for the current session
+typedef struct VisualizerStats
+{
+    unsigned long frames; // Updates that ran an FFT
+    double ms_total;      // Time spent in those updates
+    double ms_max;        // Slowest update
+} VisualizerStats;
+
+typedef struct Visualizer
+{
+    int enabled;           // 0 if turned off in the config
+    int active;            // 1 while the tap is on and updates run
+    size_t fft_size;       // Current FFT size (power of two)
+    double budget_ms;      // Update cost allowed per frame
+    double cost_ms;        // Smoothed update cost
+    unsigned int sample_rate;
+    size_t history_fill;                 // Valid samples in history
+    float history[VISUALIZER_FFT_MAX];   // Newest samples, oldest first
+    float window[VISUALIZER_FFT_MAX];    // Hann window for fft_size
+    float re[VISUALIZER_FFT_MAX / 2];    // FFT work buffers (split complex)
+    float im[VISUALIZER_FFT_MAX / 2];
+    float stage_cos[VISUALIZER_FFT_MAX / 2]; // Butterfly twiddles, stage by stage
+    float stage_sin[VISUALIZER_FFT_MAX / 2];
+    float post_cos[VISUALIZER_FFT_MAX / 2];  // Twiddles for the real-input split
+    float post_sin[VISUALIZER_FFT_MAX / 2];
+    float fall_step;                     // Level drop per frame
+    float bands[VISUALIZER_BANDS];       // Band levels, 0..1
+    float levels[PLAYER_METER_CHANNELS]; // Level bar heights, 0..1
+    unsigned int channels;               // Level bars in use
+    VisualizerStats stats;
+} Visualizer;
+
+/**
+ * Set up a visualizer
+ * vis: Visualizer to initialize
+ * enabled: 0 to keep it off for the whole session
+ * frame_hz: UI frames per second the updates run at
+ * cpu_percent: Share of one core the updates may use
+ */
+void visualizer_init(Visualizer *vis, int enabled, int frame_hz, double cpu_percent);
+
+/**
+ * Turn updates and the player's tap on or off, e.g. when the playing
+ * screen is shown or hidden
+ * vis: Visualizer
+ * player: Player to tap
+ * active: 1 to run updates, 0 to idle
+ */
+void visualizer_set_active(Visualizer *vis, Player *player, int active);
+
+/**
+ * Read new samples and recompute bands and levels (call once per frame)
+ * vis: Visualizer (does nothing unless active)
+ * player: Player to read from
+ */
+void visualizer_update(Visualizer *vis, Player *player);
+
+/**
+ * Get cost counters
+ * vis: Visualizer
+ * out: Receives the counters
+ */
+void visualizer_get_stats(const Visualizer *vis, VisualizerStats *out);
+
+#endif // WALCMAN_VISUALIZER_H